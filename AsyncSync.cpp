@@ -0,0 +1,69 @@
+#include "AsyncSync.h"
+
+using namespace std;
+
+//----------------------------------------------------------------------------
+// TryAcquire
+//----------------------------------------------------------------------------
+bool AsyncSemaphore::TryAcquire()
+{
+	int64_t count = m_count.load(memory_order_relaxed);
+	while (count > 0)
+	{
+		if (m_count.compare_exchange_weak(count, count - 1, memory_order_acq_rel, memory_order_relaxed))
+			return true;
+	}
+	return false;
+}
+
+//----------------------------------------------------------------------------
+// Release
+//----------------------------------------------------------------------------
+void AsyncSemaphore::Release()
+{
+	// No waiter committed while the count was non-negative
+	if (m_count.fetch_add(1, memory_order_acq_rel) >= 0)
+		return;
+
+	Waiter* waiter;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		waiter = m_head;
+		if (waiter)
+		{
+			m_head = static_cast<Waiter*>(waiter->next);
+			if (m_head == nullptr)
+				m_tail = nullptr;
+			waiter->m_granted = true;
+		}
+		else
+		{
+			// The waiter decremented the count but has not enqueued yet
+			m_pendingWakeups++;
+		}
+	}
+
+	if (waiter)
+		waiter->Schedule();
+}
+
+//----------------------------------------------------------------------------
+// Enqueue
+//----------------------------------------------------------------------------
+bool AsyncSemaphore::Enqueue(Waiter* waiter)
+{
+	lock_guard<mutex> lock(m_mutex);
+	if (m_pendingWakeups > 0)
+	{
+		m_pendingWakeups--;
+		return false;
+	}
+
+	waiter->next = nullptr;
+	if (m_tail)
+		m_tail->next = waiter;
+	else
+		m_head = waiter;
+	m_tail = waiter;
+	return true;
+}
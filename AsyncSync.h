@@ -0,0 +1,282 @@
+#ifndef _ASYNC_SYNC_H
+#define _ASYNC_SYNC_H
+
+// Coroutine-aware synchronization primitives for WorkerThreads.
+//
+// Blocking on std::mutex inside a coroutine stalls the worker's whole event
+// loop. These primitives suspend the awaiting coroutine instead and resume it
+// on its own WorkerThread when it can proceed. The uncontended path of the
+// semaphore and mutex is a single atomic read-modify-write; the waiter list is
+// only locked when a coroutine must actually suspend or be woken.
+
+#include "Coroutine.h"
+#include "Fault.h"
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+/// Counting semaphore whose waiters are suspended coroutines
+class AsyncSemaphore
+{
+public:
+    /// A suspended Acquire(). Release() hands its permit directly to the
+    /// waiter it wakes.
+    class Waiter : public CoroutineWaiter
+    {
+    public:
+        explicit Waiter(AsyncSemaphore& semaphore) : m_semaphore(semaphore) {}
+
+    protected:
+        /// The worker exited before resuming the coroutine. A permit handed
+        /// to it would be lost with the frame, so pass it to the next waiter.
+        void Abandon() override
+        {
+            AsyncSemaphore& semaphore = m_semaphore;
+            bool granted = m_granted;
+            m_handle.destroy();
+            if (granted)
+                semaphore.Release();
+        }
+
+    private:
+        friend class AsyncSemaphore;
+        AsyncSemaphore& m_semaphore;
+        bool m_granted = false;
+    };
+
+    /// Awaitable returned by Acquire()
+    class Awaiter
+    {
+    public:
+        explicit Awaiter(AsyncSemaphore& semaphore) : m_semaphore(semaphore), m_waiter(semaphore) {}
+
+        /// Take a permit. A negative result commits the caller to waiting.
+        bool await_ready() noexcept
+        {
+            return m_semaphore.m_count.fetch_sub(1, std::memory_order_acq_rel) > 0;
+        }
+
+        bool await_suspend(std::coroutine_handle<> handle)
+        {
+            m_waiter.Bind(handle);
+            return m_semaphore.Enqueue(&m_waiter);
+        }
+
+        void await_resume() const noexcept {}
+
+    private:
+        AsyncSemaphore& m_semaphore;
+        Waiter m_waiter;
+    };
+
+    /// Constructor
+    /// @param[in] permits - the initial number of permits
+    explicit AsyncSemaphore(int64_t permits) : m_count(permits) {}
+
+    AsyncSemaphore(const AsyncSemaphore&) = delete;
+    AsyncSemaphore& operator=(const AsyncSemaphore&) = delete;
+
+    /// Acquire a permit, suspending the coroutine until one is available
+    /// @return An awaitable
+    Awaiter Acquire() { return Awaiter(*this); }
+
+    /// Acquire a permit without waiting
+    /// @return True if a permit was acquired
+    bool TryAcquire();
+
+    /// Return a permit and resume one waiter, if any. Thread-safe.
+    void Release();
+
+    /// Get the available permits. Negative values count waiters.
+    /// @return The permit count
+    int64_t GetCount() const { return m_count.load(std::memory_order_relaxed); }
+
+private:
+    /// Add a committed waiter. Returns false if a wakeup arrived first and
+    /// the waiter already owns a permit.
+    bool Enqueue(Waiter* waiter);
+
+    std::atomic<int64_t> m_count;
+
+    // Slow path only
+    std::mutex m_mutex;
+    Waiter* m_head = nullptr;
+    Waiter* m_tail = nullptr;
+    size_t m_pendingWakeups = 0;
+};
+
+class AsyncMutex;
+
+/// Releases an AsyncMutex when destroyed
+class AsyncLockGuard
+{
+public:
+    explicit AsyncLockGuard(AsyncMutex& mutex) : m_mutex(&mutex) {}
+    AsyncLockGuard(AsyncLockGuard&& other) noexcept : m_mutex(other.m_mutex) { other.m_mutex = nullptr; }
+    ~AsyncLockGuard();
+
+private:
+    AsyncLockGuard(const AsyncLockGuard&) = delete;
+    AsyncLockGuard& operator=(const AsyncLockGuard&) = delete;
+
+    AsyncMutex* m_mutex;
+};
+
+/// Mutual exclusion for coroutines. Ownership is not tied to a thread, so a
+/// coroutine may resume on its worker and unlock there.
+class AsyncMutex
+{
+public:
+    /// Awaitable returned by ScopedLock()
+    class GuardAwaiter : public AsyncSemaphore::Awaiter
+    {
+    public:
+        explicit GuardAwaiter(AsyncMutex& mutex) : AsyncSemaphore::Awaiter(mutex.m_semaphore), m_mutex(mutex) {}
+        AsyncLockGuard await_resume() const noexcept { return AsyncLockGuard(m_mutex); }
+
+    private:
+        AsyncMutex& m_mutex;
+    };
+
+    AsyncMutex() : m_semaphore(1) {}
+
+    /// Lock the mutex, suspending the coroutine while it is held elsewhere
+    /// @return An awaitable
+    AsyncSemaphore::Awaiter Lock() { return m_semaphore.Acquire(); }
+
+    /// Lock the mutex and return a guard that unlocks it
+    /// @return An awaitable producing an AsyncLockGuard
+    GuardAwaiter ScopedLock() { return GuardAwaiter(*this); }
+
+    /// Lock the mutex without waiting
+    /// @return True if locked
+    bool TryLock() { return m_semaphore.TryAcquire(); }
+
+    /// Unlock the mutex and resume the next waiter, if any
+    void Unlock() { m_semaphore.Release(); }
+
+private:
+    AsyncSemaphore m_semaphore;
+};
+
+inline AsyncLockGuard::~AsyncLockGuard()
+{
+    if (m_mutex)
+        m_mutex->Unlock();
+}
+
+/// Bounded multi-producer multi-consumer channel for coroutines. Send()
+/// suspends while the channel is full and Receive() while it is empty. The
+/// two semaphores reserve room or an element before a sender or receiver
+/// touches the buffer, so the buffer lock is only held to move one element
+/// and never waits for another coroutine.
+template <class T>
+class AsyncChannel
+{
+public:
+    /// Constructor
+    /// @param[in] capacity - the maximum number of buffered elements
+    explicit AsyncChannel(size_t capacity) :
+        m_slots(static_cast<int64_t>(capacity)), m_items(0)
+    {
+        ASSERT_TRUE(capacity > 0);
+    }
+
+    AsyncChannel(const AsyncChannel&) = delete;
+    AsyncChannel& operator=(const AsyncChannel&) = delete;
+
+    /// Awaitable returned by Send()
+    class SendAwaiter
+    {
+    public:
+        SendAwaiter(AsyncChannel& channel, T value) :
+            m_channel(channel), m_value(std::move(value)), m_slot(channel.m_slots) {}
+
+        bool await_ready() noexcept { return m_slot.await_ready(); }
+        bool await_suspend(std::coroutine_handle<> handle) { return m_slot.await_suspend(handle); }
+        void await_resume() { m_channel.Push(std::move(m_value)); }
+
+    private:
+        AsyncChannel& m_channel;
+        T m_value;
+        AsyncSemaphore::Awaiter m_slot;
+    };
+
+    /// Awaitable returned by Receive()
+    class ReceiveAwaiter
+    {
+    public:
+        explicit ReceiveAwaiter(AsyncChannel& channel) : m_channel(channel), m_item(channel.m_items) {}
+
+        bool await_ready() noexcept { return m_item.await_ready(); }
+        bool await_suspend(std::coroutine_handle<> handle) { return m_item.await_suspend(handle); }
+        T await_resume() { return m_channel.Pop(); }
+
+    private:
+        AsyncChannel& m_channel;
+        AsyncSemaphore::Awaiter m_item;
+    };
+
+    /// Send a value, suspending while the channel is full
+    /// @param[in] value - the value
+    /// @return An awaitable
+    SendAwaiter Send(T value) { return SendAwaiter(*this, std::move(value)); }
+
+    /// Receive a value, suspending while the channel is empty
+    /// @return An awaitable producing the value
+    ReceiveAwaiter Receive() { return ReceiveAwaiter(*this); }
+
+    /// Send without waiting. Callable from any thread.
+    /// @param[in] value - the value
+    /// @return True if sent, false if the channel is full
+    bool TrySend(T value)
+    {
+        if (!m_slots.TryAcquire())
+            return false;
+        Push(std::move(value));
+        return true;
+    }
+
+    /// Receive without waiting. Callable from any thread.
+    /// @return The value, or empty if the channel is empty
+    std::optional<T> TryReceive()
+    {
+        if (!m_items.TryAcquire())
+            return std::nullopt;
+        return Pop();
+    }
+
+private:
+    /// Store into the room reserved by a slot permit
+    void Push(T value)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_buffer.push_back(std::move(value));
+        }
+        m_items.Release();
+    }
+
+    /// Take the element reserved by an item permit
+    T Pop()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        ASSERT_TRUE(!m_buffer.empty());
+        T value = std::move(m_buffer.front());
+        m_buffer.pop_front();
+        lock.unlock();
+        m_slots.Release();
+        return value;
+    }
+
+    AsyncSemaphore m_slots;
+    AsyncSemaphore m_items;
+    std::mutex m_mutex;
+    std::deque<T> m_buffer;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include "BlockPool.h"
+#include <mutex>
+
+using namespace std;
+
+namespace
+{
+	const size_t BLOCK_ALIGN = alignof(max_align_t);
+	const size_t NUM_CLASSES = BlockPool::MAX_BLOCK_SIZE / BLOCK_ALIGN;
+	const size_t BLOCKS_PER_CHUNK = 64;
+
+	struct FreeBlock
+	{
+		FreeBlock* next;
+	};
+
+	struct SizeClass
+	{
+		mutex lock;
+		FreeBlock* head = nullptr;
+	};
+
+	// Never destroyed so blocks may be freed during static destruction
+	SizeClass* GetClasses()
+	{
+		static SizeClass* classes = new SizeClass[NUM_CLASSES];
+		return classes;
+	}
+
+	size_t ClassIndex(size_t size)
+	{
+		return size == 0 ? 0 : (size - 1) / BLOCK_ALIGN;
+	}
+}
+
+//----------------------------------------------------------------------------
+// Allocate
+//----------------------------------------------------------------------------
+void* BlockPool::Allocate(size_t size)
+{
+	if (size > MAX_BLOCK_SIZE)
+		return ::operator new(size);
+
+	size_t index = ClassIndex(size);
+	SizeClass& sizeClass = GetClasses()[index];
+
+	lock_guard<mutex> lock(sizeClass.lock);
+	if (sizeClass.head == nullptr)
+	{
+		// Carve a new chunk into blocks and thread them onto the free list
+		size_t blockSize = (index + 1) * BLOCK_ALIGN;
+		char* chunk = static_cast<char*>(::operator new(blockSize * BLOCKS_PER_CHUNK));
+		for (size_t i = 0; i < BLOCKS_PER_CHUNK; i++)
+		{
+			FreeBlock* block = reinterpret_cast<FreeBlock*>(chunk + i * blockSize);
+			block->next = sizeClass.head;
+			sizeClass.head = block;
+		}
+	}
+
+	FreeBlock* block = sizeClass.head;
+	sizeClass.head = block->next;
+	return block;
+}
+
+//----------------------------------------------------------------------------
+// Deallocate
+//----------------------------------------------------------------------------
+void BlockPool::Deallocate(void* ptr, size_t size)
+{
+	if (ptr == nullptr)
+		return;
+
+	if (size > MAX_BLOCK_SIZE)
+	{
+		::operator delete(ptr);
+		return;
+	}
+
+	SizeClass& sizeClass = GetClasses()[ClassIndex(size)];
+	FreeBlock* block = static_cast<FreeBlock*>(ptr);
+
+	lock_guard<mutex> lock(sizeClass.lock);
+	block->next = sizeClass.head;
+	sizeClass.head = block;
+}
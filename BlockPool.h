@@ -0,0 +1,48 @@
+#ifndef _BLOCK_POOL_H
+#define _BLOCK_POOL_H
+
+// Fixed block memory pool for small, frequently allocated objects such as
+// future shared state. Blocks are carved from chunks that are never returned
+// to the heap; freed blocks are recycled through per size class free lists.
+
+#include <cstddef>
+#include <new>
+
+class BlockPool
+{
+public:
+    /// Largest block size served from the pool. Larger requests use the heap.
+    static const size_t MAX_BLOCK_SIZE = 512;
+
+    /// Allocate a block
+    /// @param[in] size - the number of bytes
+    /// @return The block, aligned for any fundamental type
+    static void* Allocate(size_t size);
+
+    /// Return a block to the pool
+    /// @param[in] ptr - a block from Allocate()
+    /// @param[in] size - the size passed to Allocate()
+    static void Deallocate(void* ptr, size_t size);
+};
+
+/// Standard allocator drawing from BlockPool, e.g. for std::allocate_shared
+template <class T>
+class PoolAllocator
+{
+public:
+    typedef T value_type;
+
+    PoolAllocator() = default;
+    template <class U>
+    PoolAllocator(const PoolAllocator<U>&) {}
+
+    T* allocate(size_t n) { return static_cast<T*>(BlockPool::Allocate(n * sizeof(T))); }
+    void deallocate(T* ptr, size_t n) { BlockPool::Deallocate(ptr, n * sizeof(T)); }
+
+    template <class U>
+    bool operator==(const PoolAllocator<U>&) const { return true; }
+    template <class U>
+    bool operator!=(const PoolAllocator<U>&) const { return false; }
+};
+
+#endif
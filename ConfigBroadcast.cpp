@@ -0,0 +1,72 @@
+#include "ConfigBroadcast.h"
+
+using namespace std;
+
+std::atomic<uint64_t> ConfigBroadcastBase::s_version{1};
+
+namespace
+{
+	// Registry of all configurations indexed by id. Never destroyed so global
+	// configurations may outlive it during static destruction.
+	struct Registry
+	{
+		mutex lock;
+		vector<atomic<const void*>*> slots;
+	};
+
+	Registry& GetRegistry()
+	{
+		static Registry* registry = new Registry();
+		return *registry;
+	}
+}
+
+//----------------------------------------------------------------------------
+// ConfigBroadcastBase
+//----------------------------------------------------------------------------
+ConfigBroadcastBase::ConfigBroadcastBase()
+{
+	Registry& registry = GetRegistry();
+	lock_guard<mutex> lock(registry.lock);
+	m_id = registry.slots.size();
+	registry.slots.push_back(&m_current);
+}
+
+//----------------------------------------------------------------------------
+// ~ConfigBroadcastBase
+//----------------------------------------------------------------------------
+ConfigBroadcastBase::~ConfigBroadcastBase()
+{
+	Registry& registry = GetRegistry();
+	{
+		lock_guard<mutex> lock(registry.lock);
+		registry.slots[m_id] = nullptr;
+	}
+	s_version.fetch_add(1, memory_order_seq_cst);
+}
+
+//----------------------------------------------------------------------------
+// Store
+//----------------------------------------------------------------------------
+void ConfigBroadcastBase::Store(const void* snapshot)
+{
+	m_current.store(snapshot, memory_order_release);
+
+	// Bump the version before the caller retires the previous snapshot so a
+	// worker that passes the grace period also observes the change
+	s_version.fetch_add(1, memory_order_seq_cst);
+}
+
+//----------------------------------------------------------------------------
+// RefreshAll
+//----------------------------------------------------------------------------
+void ConfigBroadcastBase::RefreshAll(vector<const void*>& snapshots, uint64_t& version)
+{
+	Registry& registry = GetRegistry();
+	lock_guard<mutex> lock(registry.lock);
+
+	version = s_version.load(memory_order_acquire);
+	snapshots.resize(registry.slots.size());
+	for (size_t i = 0; i < registry.slots.size(); i++)
+		snapshots[i] = registry.slots[i] ? registry.slots[i]->load(memory_order_acquire) : nullptr;
+}
@@ -0,0 +1,132 @@
+#ifndef _CONFIG_BROADCAST_H
+#define _CONFIG_BROADCAST_H
+
+// Versioned configuration broadcast to all WorkerThreads.
+//
+// A writer publishes an immutable snapshot once. Each WorkerThread picks up
+// the latest snapshots at a message boundary and caches the pointers, so a
+// handler reading configuration performs a plain pointer load with no locks
+// or atomics. Superseded snapshots are reclaimed through Qsbr once every
+// worker has moved past them.
+
+#include "WorkerThread.h"
+#include "Qsbr.h"
+#include "Fault.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+class ConfigBroadcastBase
+{
+public:
+    /// Refresh a worker's snapshot table if any configuration changed. Called
+    /// by WorkerThread::Process() before each message dispatch.
+    /// @param[in,out] snapshots - the worker's cached snapshot pointers
+    /// @param[in,out] version - the global version the table reflects
+    static void Refresh(std::vector<const void*>& snapshots, uint64_t& version)
+    {
+        if (s_version.load(std::memory_order_acquire) != version)
+            RefreshAll(snapshots, version);
+    }
+
+protected:
+    ConfigBroadcastBase();
+    ~ConfigBroadcastBase();
+
+    /// Make a new snapshot visible to workers at their next message boundary
+    /// @param[in] snapshot - the new snapshot
+    void Store(const void* snapshot);
+
+    /// Get the snapshot cached by a worker, or the latest if not yet cached
+    /// @param[in] worker - a running worker thread
+    /// @return The snapshot pointer
+    const void* Snapshot(const WorkerThread& worker) const
+    {
+        const std::vector<const void*>& snapshots = worker.m_configSnapshots;
+        if (m_id < snapshots.size() && snapshots[m_id] != nullptr)
+            return snapshots[m_id];
+        return m_current.load(std::memory_order_acquire);
+    }
+
+private:
+    ConfigBroadcastBase(const ConfigBroadcastBase&) = delete;
+    ConfigBroadcastBase& operator=(const ConfigBroadcastBase&) = delete;
+
+    static void RefreshAll(std::vector<const void*>& snapshots, uint64_t& version);
+
+    std::atomic<const void*> m_current{nullptr};
+    size_t m_id;
+
+    static std::atomic<uint64_t> s_version;
+};
+
+/// An immutable configuration of type T broadcast to all worker threads
+template <class T>
+class ConfigBroadcast : public ConfigBroadcastBase
+{
+public:
+    /// Constructor
+    /// @param[in] initial - the initial configuration
+    explicit ConfigBroadcast(const T& initial)
+    {
+        Publish(initial);
+    }
+
+    /// Destructor. The last snapshot is reclaimed after a grace period.
+    ~ConfigBroadcast()
+    {
+        Qsbr::Instance().Retire(new std::shared_ptr<const T>(std::move(m_latest)));
+    }
+
+    /// Publish a new configuration to all worker threads. Thread-safe.
+    /// @param[in] config - the new configuration
+    void Publish(const T& config)
+    {
+        std::shared_ptr<const T> snapshot = std::make_shared<const T>(config);
+        std::shared_ptr<const T> previous;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            previous = m_latest;
+            m_latest = snapshot;
+            Store(snapshot.get());
+        }
+
+        // Workers may still cache the previous snapshot until their next boundary
+        if (previous)
+            Qsbr::Instance().Retire(new std::shared_ptr<const T>(std::move(previous)));
+    }
+
+    /// Get the configuration snapshot of the calling worker thread. The
+    /// reference is valid until the current message handler returns.
+    /// @return The current worker's configuration
+    const T& Get() const
+    {
+        WorkerThread* worker = WorkerThread::GetCurrentWorker();
+        ASSERT_TRUE(worker != nullptr);
+        return Get(*worker);
+    }
+
+    /// Get the configuration snapshot of a worker. Only call from that worker.
+    /// @param[in] worker - the calling worker thread
+    /// @return The worker's configuration
+    const T& Get(const WorkerThread& worker) const
+    {
+        return *static_cast<const T*>(Snapshot(worker));
+    }
+
+    /// Get the latest configuration from any thread
+    /// @return A reference counted copy of the latest snapshot
+    std::shared_ptr<const T> Latest() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_latest;
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    std::shared_ptr<const T> m_latest;
+};
+
+#endif
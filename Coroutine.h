@@ -0,0 +1,85 @@
+#ifndef _COROUTINE_H
+#define _COROUTINE_H
+
+// C++20 coroutine support for WorkerThreads.
+//
+// WorkerTask is a fire-and-forget coroutine type. It starts on the calling
+// thread; co_await ResumeOn(worker) continues it on a worker's event loop.
+// Suspended coroutines are resumed through the worker's intrusive work list,
+// so hopping threads allocates nothing beyond the coroutine frame.
+
+#include "WorkerThread.h"
+#include "Fault.h"
+#include <coroutine>
+
+/// Fire-and-forget coroutine return type. The frame is destroyed when the
+/// coroutine completes.
+struct WorkerTask
+{
+    struct promise_type
+    {
+        WorkerTask get_return_object() noexcept { return WorkerTask(); }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { ASSERT(); }
+    };
+};
+
+/// A suspended coroutine queued for resumption on a worker thread. If the
+/// worker exits first, the coroutine frame is destroyed.
+class CoroutineWaiter : public WorkItem
+{
+public:
+    /// Record the coroutine and the worker it is suspended on, if any
+    /// @param[in] handle - the suspended coroutine
+    void Bind(std::coroutine_handle<> handle)
+    {
+        m_handle = handle;
+        m_worker = WorkerThread::GetCurrentWorker();
+    }
+
+    /// Resume the coroutine on its own worker thread, or inline on the calling
+    /// thread if it was not suspended on a worker
+    void Schedule()
+    {
+        if (m_worker)
+            m_worker->PostWork(this);
+        else
+            m_handle.resume();
+    }
+
+    /// Link for intrusive waiter lists
+    CoroutineWaiter* next = nullptr;
+
+protected:
+    void Execute() override { m_handle.resume(); }
+    void Abandon() override { m_handle.destroy(); }
+
+    std::coroutine_handle<> m_handle;
+    WorkerThread* m_worker = nullptr;
+};
+
+/// Awaitable that continues the awaiting coroutine on a worker thread.
+/// Continues immediately if already running on that worker.
+class ResumeOn : public CoroutineWaiter
+{
+public:
+    explicit ResumeOn(WorkerThread& worker) : m_target(&worker) {}
+
+    bool await_ready() const noexcept { return WorkerThread::GetCurrentWorker() == m_target; }
+
+    void await_suspend(std::coroutine_handle<> handle)
+    {
+        m_handle = handle;
+        m_worker = m_target;
+        m_target->PostWork(this);
+    }
+
+    void await_resume() const noexcept {}
+
+private:
+    WorkerThread* m_target;
+};
+
+#endif
@@ -0,0 +1,335 @@
+#include "Fiber.h"
+#include "WorkerLocal.h"
+
+#ifdef WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstdint>
+#endif
+
+using namespace std;
+
+namespace
+{
+	// Per-worker context the event loop is saved in while a fiber runs
+	struct FiberHost
+	{
+#ifdef WIN32
+		void* fiber = nullptr;
+		bool converted = false;
+
+		~FiberHost()
+		{
+			if (converted)
+				ConvertFiberToThread();
+		}
+#else
+		ucontext_t context;
+#endif
+	};
+
+	WorkerLocal<FiberHost> s_host;
+
+	thread_local Fiber* t_currentFiber = nullptr;
+
+	// Never destroyed so pooled fibers outlive static destruction
+	struct Pool
+	{
+		mutex lock;
+		vector<Fiber*> fibers;
+	};
+
+	Pool& GetPool()
+	{
+		static Pool* pool = new Pool();
+		return *pool;
+	}
+}
+
+//----------------------------------------------------------------------------
+// Fiber
+//----------------------------------------------------------------------------
+Fiber::Fiber() : m_worker(nullptr), m_started(false), m_finished(false)
+{
+#ifdef WIN32
+	m_host = nullptr;
+	m_handle = CreateFiberEx(0, STACK_SIZE, FIBER_FLAG_FLOAT_SWITCH, reinterpret_cast<LPFIBER_START_ROUTINE>(&Fiber::Entry), this);
+	ASSERT_TRUE(m_handle != nullptr);
+#else
+	m_host = nullptr;
+
+	// Reserve the stack plus a guard page at its low end; stacks grow down
+	size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+	m_stackBytes = STACK_SIZE + pageSize;
+	m_stack = mmap(nullptr, m_stackBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	ASSERT_TRUE(m_stack != MAP_FAILED);
+	ASSERT_TRUE(mprotect(m_stack, pageSize, PROT_NONE) == 0);
+
+	getcontext(&m_context);
+	m_context.uc_stack.ss_sp = static_cast<char*>(m_stack) + pageSize;
+	m_context.uc_stack.ss_size = STACK_SIZE;
+	m_context.uc_link = nullptr;
+
+	// makecontext() only passes int arguments, so split the pointer
+	uintptr_t self = reinterpret_cast<uintptr_t>(this);
+	makecontext(&m_context, reinterpret_cast<void (*)()>(&Fiber::Entry), 2,
+		static_cast<unsigned int>(static_cast<uint64_t>(self) >> 32), static_cast<unsigned int>(self & 0xFFFFFFFF));
+#endif
+}
+
+//----------------------------------------------------------------------------
+// ~Fiber
+//----------------------------------------------------------------------------
+Fiber::~Fiber()
+{
+#ifdef WIN32
+	DeleteFiber(m_handle);
+#else
+	munmap(m_stack, m_stackBytes);
+#endif
+}
+
+//----------------------------------------------------------------------------
+// Entry
+//----------------------------------------------------------------------------
+#ifdef WIN32
+void __stdcall Fiber::Entry(void* param)
+{
+	static_cast<Fiber*>(param)->Run();
+}
+#else
+void Fiber::Entry(unsigned int hi, unsigned int lo)
+{
+	uintptr_t self = static_cast<uintptr_t>((static_cast<uint64_t>(hi) << 32) | lo);
+	reinterpret_cast<Fiber*>(self)->Run();
+}
+#endif
+
+//----------------------------------------------------------------------------
+// Run
+//----------------------------------------------------------------------------
+void Fiber::Run()
+{
+	// Never returns. Each pass runs one body then parks until reused.
+	while (1)
+	{
+		m_func();
+		m_func = nullptr;
+		m_finished = true;
+		SwitchOut();
+	}
+}
+
+//----------------------------------------------------------------------------
+// Spawn
+//----------------------------------------------------------------------------
+void Fiber::Spawn(WorkerThread& worker, std::function<void()> func)
+{
+	ASSERT_TRUE(func);
+
+	Fiber* fiber = Acquire();
+	fiber->m_func = std::move(func);
+	fiber->m_worker = &worker;
+	fiber->m_started = false;
+	fiber->m_finished = false;
+	fiber->Resume();
+}
+
+//----------------------------------------------------------------------------
+// Current
+//----------------------------------------------------------------------------
+Fiber* Fiber::Current()
+{
+	return t_currentFiber;
+}
+
+//----------------------------------------------------------------------------
+// Suspend
+//----------------------------------------------------------------------------
+void Fiber::Suspend()
+{
+	Fiber* fiber = t_currentFiber;
+	ASSERT_TRUE(fiber != nullptr);
+	fiber->SwitchOut();
+}
+
+//----------------------------------------------------------------------------
+// Reschedule
+//----------------------------------------------------------------------------
+void Fiber::Reschedule()
+{
+	Fiber* fiber = t_currentFiber;
+	ASSERT_TRUE(fiber != nullptr);
+
+	// The resume is queued behind messages already pending on the worker
+	fiber->Resume();
+	fiber->SwitchOut();
+}
+
+//----------------------------------------------------------------------------
+// Resume
+//----------------------------------------------------------------------------
+void Fiber::Resume()
+{
+	m_worker->PostWork(this);
+}
+
+//----------------------------------------------------------------------------
+// Execute
+//----------------------------------------------------------------------------
+void Fiber::Execute()
+{
+	ASSERT_TRUE(t_currentFiber == nullptr);
+	ASSERT_TRUE(WorkerThread::GetCurrentWorker() == m_worker);
+
+	FiberHost& host = s_host.Get();
+	t_currentFiber = this;
+	m_started = true;
+
+#ifdef WIN32
+	if (!host.fiber)
+	{
+		host.fiber = ConvertThreadToFiber(nullptr);
+		if (host.fiber)
+			host.converted = true;
+		else
+			host.fiber = GetCurrentFiber();
+	}
+	m_host = host.fiber;
+	SwitchToFiber(m_handle);
+#else
+	m_host = &host.context;
+	swapcontext(&host.context, &m_context);
+#endif
+
+	t_currentFiber = nullptr;
+	if (m_finished)
+		Release(this);
+}
+
+//----------------------------------------------------------------------------
+// Abandon
+//----------------------------------------------------------------------------
+void Fiber::Abandon()
+{
+	// A fiber that never started holds no stack frames and can be reused.
+	// A suspended fiber cannot be unwound and is leaked with its stack.
+	if (!m_started)
+	{
+		m_func = nullptr;
+		Release(this);
+	}
+}
+
+//----------------------------------------------------------------------------
+// SwitchOut
+//----------------------------------------------------------------------------
+void Fiber::SwitchOut()
+{
+#ifdef WIN32
+	SwitchToFiber(m_host);
+#else
+	swapcontext(&m_context, m_host);
+#endif
+}
+
+//----------------------------------------------------------------------------
+// Acquire
+//----------------------------------------------------------------------------
+Fiber* Fiber::Acquire()
+{
+	Pool& pool = GetPool();
+	{
+		lock_guard<mutex> lock(pool.lock);
+		if (!pool.fibers.empty())
+		{
+			Fiber* fiber = pool.fibers.back();
+			pool.fibers.pop_back();
+			return fiber;
+		}
+	}
+	return new Fiber();
+}
+
+//----------------------------------------------------------------------------
+// Release
+//----------------------------------------------------------------------------
+void Fiber::Release(Fiber* fiber)
+{
+	Pool& pool = GetPool();
+	{
+		lock_guard<mutex> lock(pool.lock);
+		if (pool.fibers.size() < MAX_POOLED)
+		{
+			pool.fibers.push_back(fiber);
+			return;
+		}
+	}
+	delete fiber;
+}
+
+//----------------------------------------------------------------------------
+// GetPooledCount
+//----------------------------------------------------------------------------
+size_t Fiber::GetPooledCount()
+{
+	Pool& pool = GetPool();
+	lock_guard<mutex> lock(pool.lock);
+	return pool.fibers.size();
+}
+
+//----------------------------------------------------------------------------
+// FiberEvent::Wait
+//----------------------------------------------------------------------------
+void FiberEvent::Wait()
+{
+	Fiber* fiber = Fiber::Current();
+	ASSERT_TRUE(fiber != nullptr);
+
+	{
+		lock_guard<mutex> lock(m_mutex);
+		if (m_set)
+			return;
+		m_waiters.push_back(fiber);
+	}
+
+	// Set() may resume the fiber before it suspends. The resume is posted to
+	// this worker so it cannot run until the fiber has switched out.
+	Fiber::Suspend();
+}
+
+//----------------------------------------------------------------------------
+// FiberEvent::Set
+//----------------------------------------------------------------------------
+void FiberEvent::Set()
+{
+	vector<Fiber*> waiters;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_set = true;
+		waiters.swap(m_waiters);
+	}
+
+	for (Fiber* fiber : waiters)
+		fiber->Resume();
+}
+
+//----------------------------------------------------------------------------
+// FiberEvent::Reset
+//----------------------------------------------------------------------------
+void FiberEvent::Reset()
+{
+	lock_guard<mutex> lock(m_mutex);
+	m_set = false;
+}
+
+//----------------------------------------------------------------------------
+// FiberEvent::IsSet
+//----------------------------------------------------------------------------
+bool FiberEvent::IsSet()
+{
+	lock_guard<mutex> lock(m_mutex);
+	return m_set;
+}
@@ -0,0 +1,142 @@
+#ifndef _FIBER_H
+#define _FIBER_H
+
+// Cooperative stackful fibers running on a WorkerThread.
+//
+// A fiber is dispatched by its worker's event loop like any other work item.
+// When the fiber waits (FiberEvent::Wait(), FiberAwait(), Fiber::Reschedule())
+// it switches back to Process() so the loop keeps dispatching messages, and is
+// resumed on the same worker once the wait completes. A fiber never migrates
+// between workers. Each wait is a message boundary, so a fiber must not hold
+// RcuPtr or ConfigBroadcast references across a wait.
+//
+// Fibers and their stacks are pooled. On POSIX each stack is mmap'd with a
+// PROT_NONE guard page below it so an overflow faults instead of corrupting
+// memory; Windows fibers get a guard page from CreateFiberEx.
+
+#include "WorkerThread.h"
+#include "Future.h"
+#include "Fault.h"
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+#ifndef WIN32
+#include <ucontext.h>
+#endif
+
+class Fiber final : public WorkItem
+{
+public:
+    /// Usable stack size of each fiber
+    static const size_t STACK_SIZE = 64 * 1024;
+
+    /// Maximum number of idle fibers kept for reuse
+    static const size_t MAX_POOLED = 64;
+
+    /// Run a function on a fiber dispatched by a worker thread
+    /// @param[in] worker - the worker thread the fiber runs on
+    /// @param[in] func - the fiber body
+    static void Spawn(WorkerThread& worker, std::function<void()> func);
+
+    /// Get the fiber running on the calling thread
+    /// @return The current fiber, or nullptr if not called from a fiber
+    static Fiber* Current();
+
+    /// Suspend the current fiber until Resume() is called. Called by wait
+    /// primitives; each Suspend() must be matched by exactly one Resume().
+    static void Suspend();
+
+    /// Let other pending messages on the worker run, then continue
+    static void Reschedule();
+
+    /// Schedule a suspended fiber to continue on its worker. Thread-safe.
+    void Resume();
+
+    /// Get the number of idle fibers in the pool
+    /// @return The pooled fiber count
+    static size_t GetPooledCount();
+
+private:
+    Fiber();
+    ~Fiber();
+    Fiber(const Fiber&) = delete;
+    Fiber& operator=(const Fiber&) = delete;
+
+    /// Switch from the worker's event loop into this fiber
+    void Execute() override;
+
+    /// The worker exited before the fiber could continue
+    void Abandon() override;
+
+    /// Switch from this fiber back to the worker's event loop
+    void SwitchOut();
+
+    /// Fiber entry point. Runs successive bodies while the fiber is pooled.
+    void Run();
+
+    static Fiber* Acquire();
+    static void Release(Fiber* fiber);
+
+#ifdef WIN32
+    static void __stdcall Entry(void* param);
+    void* m_handle;
+    void* m_host;
+#else
+    static void Entry(unsigned int hi, unsigned int lo);
+    ucontext_t m_context;
+    ucontext_t* m_host;
+    void* m_stack;
+    size_t m_stackBytes;
+#endif
+
+    std::function<void()> m_func;
+    WorkerThread* m_worker;
+    bool m_started;
+    bool m_finished;
+};
+
+/// Manual reset event that suspends waiting fibers instead of blocking the worker
+class FiberEvent
+{
+public:
+    /// Suspend the current fiber until the event is set
+    void Wait();
+
+    /// Set the event and resume all waiting fibers. Thread-safe.
+    void Set();
+
+    /// Clear the event
+    void Reset();
+
+    /// @return True if the event is set
+    bool IsSet();
+
+private:
+    std::mutex m_mutex;
+    bool m_set = false;
+    std::vector<Fiber*> m_waiters;
+};
+
+/// Suspend the current fiber until a future is ready
+/// @param[in] future - the future, consumed
+/// @return The value
+template <class T>
+typename FutureValue<T>::type FiberAwait(Future<T> future)
+{
+    typedef typename FutureValue<T>::type Value;
+
+    Fiber* fiber = Fiber::Current();
+    ASSERT_TRUE(fiber != nullptr);
+
+    std::optional<Value> result;
+    future.OnReady([&result, fiber](Value& value) {
+        result.emplace(std::move(value));
+        fiber->Resume();
+    });
+    Fiber::Suspend();
+    return std::move(*result);
+}
+
+#endif
@@ -0,0 +1,298 @@
+#ifndef _FUTURE_H
+#define _FUTURE_H
+
+// Lightweight future/promise whose continuations run on a chosen WorkerThread.
+//
+// Unlike std::future, no thread ever blocks waiting for a value. A continuation
+// attached with Then(worker, f) is posted to the worker's queue the moment the
+// value is set. WhenAll() and WhenAny() combine futures without blocking.
+// Shared state is allocated from BlockPool.
+//
+// Each Future has a single consumer: Then(), WhenAll() and WhenAny() consume it.
+
+#include "WorkerThread.h"
+#include "BlockPool.h"
+#include "Fault.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+template <class T> class Future;
+template <class T> class Promise;
+
+/// Value stored by a Future<void>
+struct FutureUnit {};
+
+template <class T> struct FutureValue { typedef T type; };
+template <> struct FutureValue<void> { typedef FutureUnit type; };
+
+/// Result type of a continuation invoked with the value of a Future<T>
+template <class F, class T> struct ContinuationResult { typedef std::invoke_result_t<F, T> type; };
+template <class F> struct ContinuationResult<F, void> { typedef std::invoke_result_t<F> type; };
+
+/// Shared state between a Promise and its Future
+template <class T>
+class FutureState : public std::enable_shared_from_this<FutureState<T>>
+{
+public:
+    typedef typename FutureValue<T>::type Value;
+
+    /// Set the value and run the continuation if one is attached
+    void SetValue(Value&& value)
+    {
+        ASSERT_TRUE(!m_claimed.exchange(true, std::memory_order_relaxed));
+        m_value.emplace(std::move(value));
+        if (m_flags.fetch_or(VALUE, std::memory_order_acq_rel) & CONTINUATION)
+            Run();
+    }
+
+    /// Attach the continuation. Runs immediately if the value is already set.
+    void SetContinuation(std::function<void(FutureState&)> continuation)
+    {
+        m_continuation = std::move(continuation);
+        if (m_flags.fetch_or(CONTINUATION, std::memory_order_acq_rel) & VALUE)
+            Run();
+    }
+
+    bool IsReady() const { return (m_flags.load(std::memory_order_acquire) & VALUE) != 0; }
+
+    Value& GetValue()
+    {
+        ASSERT_TRUE(IsReady());
+        return *m_value;
+    }
+
+private:
+    enum { VALUE = 1, CONTINUATION = 2 };
+
+    void Run()
+    {
+        // Release the continuation before it runs so captured state is freed
+        std::function<void(FutureState&)> continuation = std::move(m_continuation);
+        m_continuation = nullptr;
+        continuation(*this);
+    }
+
+    std::atomic<int> m_flags{0};
+    std::atomic<bool> m_claimed{false};
+    std::optional<Value> m_value;
+    std::function<void(FutureState&)> m_continuation;
+};
+
+/// Producer side of a Future. Copies refer to the same shared state; the
+/// value must be set exactly once.
+template <class T>
+class Promise
+{
+public:
+    typedef typename FutureValue<T>::type Value;
+
+    Promise() : m_state(std::allocate_shared<FutureState<T>>(PoolAllocator<FutureState<T>>())) {}
+
+    /// Get the future associated with this promise
+    /// @return The future
+    Future<T> GetFuture() const { return Future<T>(m_state); }
+
+    /// Set the value. Any continuation is scheduled on its worker.
+    /// @param[in] value - the value
+    void SetValue(Value value) { m_state->SetValue(std::move(value)); }
+
+    /// Complete a Promise<void>
+    void SetValue()
+    {
+        static_assert(std::is_void<T>::value, "SetValue() requires a value");
+        m_state->SetValue(FutureUnit());
+    }
+
+private:
+    std::shared_ptr<FutureState<T>> m_state;
+};
+
+/// Consumer side of a Promise
+template <class T>
+class Future
+{
+public:
+    typedef typename FutureValue<T>::type Value;
+
+    Future() = default;
+    Future(Future&&) = default;
+    Future& operator=(Future&&) = default;
+
+    /// Create a future that is already ready
+    /// @param[in] value - the value
+    /// @return The ready future
+    static Future MakeReady(Value value)
+    {
+        Promise<T> promise;
+        promise.SetValue(std::move(value));
+        return promise.GetFuture();
+    }
+
+    /// @return True if the future refers to shared state
+    bool IsValid() const { return m_state != nullptr; }
+
+    /// @return True if the value has been set
+    bool IsReady() const { return m_state && m_state->IsReady(); }
+
+    /// Get the value of a ready future. Does not block.
+    /// @return The value
+    Value& Get()
+    {
+        ASSERT_TRUE(m_state);
+        return m_state->GetValue();
+    }
+
+    /// Attach a continuation that is posted to a worker thread when the value
+    /// is ready. Consumes this future.
+    /// @param[in] worker - the worker thread to run the continuation on
+    /// @param[in] f - invoked with the value (or no arguments for Future<void>)
+    /// @return A future for the continuation's result
+    template <class F>
+    Future<typename ContinuationResult<F, T>::type> Then(WorkerThread& worker, F f)
+    {
+        typedef typename ContinuationResult<F, T>::type R;
+        ASSERT_TRUE(m_state);
+
+        Promise<R> promise;
+        Future<R> result = promise.GetFuture();
+        WorkerThread* target = &worker;
+
+        std::shared_ptr<FutureState<T>> state = std::move(m_state);
+        state->SetContinuation([target, f, promise](FutureState<T>& ready) {
+            std::shared_ptr<FutureState<T>> self = ready.shared_from_this();
+            target->PostTask([self, f, promise]() mutable {
+                Invoke(f, promise, self->GetValue());
+            });
+        });
+        return result;
+    }
+
+    /// Attach a continuation that runs inline on the thread that sets the
+    /// value. Intended for short non-blocking completions. Consumes this future.
+    /// @param[in] f - invoked with the value
+    void OnReady(std::function<void(Value&)> f)
+    {
+        ASSERT_TRUE(m_state);
+        std::shared_ptr<FutureState<T>> state = std::move(m_state);
+        state->SetContinuation([f](FutureState<T>& ready) { f(ready.GetValue()); });
+    }
+
+private:
+    template <class> friend class Promise;
+
+    explicit Future(std::shared_ptr<FutureState<T>> state) : m_state(std::move(state)) {}
+
+    Future(const Future&) = delete;
+    Future& operator=(const Future&) = delete;
+
+    template <class F, class R>
+    static void Invoke(F& f, Promise<R>& promise, Value& value)
+    {
+        if constexpr (std::is_void<T>::value)
+        {
+            if constexpr (std::is_void<R>::value) { f(); promise.SetValue(); }
+            else promise.SetValue(f());
+        }
+        else
+        {
+            if constexpr (std::is_void<R>::value) { f(std::move(value)); promise.SetValue(); }
+            else promise.SetValue(f(std::move(value)));
+        }
+    }
+
+    std::shared_ptr<FutureState<T>> m_state;
+};
+
+template <class T> struct WhenAllResult { typedef std::vector<T> type; };
+template <> struct WhenAllResult<void> { typedef void type; };
+
+template <class T> struct WhenAnyResult { typedef std::pair<size_t, T> type; };
+template <> struct WhenAnyResult<void> { typedef size_t type; };
+
+/// Combine futures into one that is ready when all inputs are ready
+/// @param[in] futures - the inputs, consumed
+/// @return A future of all values in input order (void for Future<void> inputs)
+template <class T>
+Future<typename WhenAllResult<T>::type> WhenAll(std::vector<Future<T>> futures)
+{
+    typedef typename WhenAllResult<T>::type R;
+    typedef typename FutureValue<T>::type Value;
+
+    struct Join
+    {
+        std::atomic<size_t> remaining;
+        std::vector<std::optional<Value>> values;
+        Promise<R> promise;
+    };
+
+    std::shared_ptr<Join> join = std::allocate_shared<Join>(PoolAllocator<Join>());
+    join->remaining = futures.size();
+    join->values.resize(futures.size());
+    Future<R> result = join->promise.GetFuture();
+
+    auto complete = [](Join& j) {
+        if constexpr (std::is_void<T>::value)
+            j.promise.SetValue();
+        else
+        {
+            std::vector<T> values;
+            values.reserve(j.values.size());
+            for (auto& v : j.values)
+                values.push_back(std::move(*v));
+            j.promise.SetValue(std::move(values));
+        }
+    };
+
+    if (futures.empty())
+        complete(*join);
+
+    for (size_t i = 0; i < futures.size(); i++)
+    {
+        futures[i].OnReady([join, i, complete](Value& value) {
+            join->values[i].emplace(std::move(value));
+            if (join->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                complete(*join);
+        });
+    }
+    return result;
+}
+
+/// Combine futures into one that is ready when the first input is ready
+/// @param[in] futures - the inputs, consumed. Must not be empty.
+/// @return A future of the first index and value (index only for Future<void>)
+template <class T>
+Future<typename WhenAnyResult<T>::type> WhenAny(std::vector<Future<T>> futures)
+{
+    typedef typename WhenAnyResult<T>::type R;
+    typedef typename FutureValue<T>::type Value;
+    ASSERT_TRUE(!futures.empty());
+
+    struct Race
+    {
+        std::atomic<bool> done{false};
+        Promise<R> promise;
+    };
+
+    std::shared_ptr<Race> race = std::allocate_shared<Race>(PoolAllocator<Race>());
+    Future<R> result = race->promise.GetFuture();
+
+    for (size_t i = 0; i < futures.size(); i++)
+    {
+        futures[i].OnReady([race, i](Value& value) {
+            if (race->done.exchange(true, std::memory_order_acq_rel))
+                return;
+            if constexpr (std::is_void<T>::value)
+                race->promise.SetValue(i);
+            else
+                race->promise.SetValue(R(i, std::move(value)));
+        });
+    }
+    return result;
+}
+
+#endif
@@ -0,0 +1,45 @@
+#include "InstrumentedMutex.h"
+
+using namespace std;
+
+//----------------------------------------------------------------------------
+// Wait
+//----------------------------------------------------------------------------
+void InstrumentedMutex::Wait(condition_variable& cv)
+{
+	Add(m_holdTicks, Elapsed(m_holdStart));
+
+	// The condition variable releases and reacquires the native mutex
+	unique_lock<mutex> native(m_mutex, adopt_lock);
+	cv.wait(native);
+	native.release();
+
+	Acquired();
+}
+
+//----------------------------------------------------------------------------
+// WaitFor
+//----------------------------------------------------------------------------
+void InstrumentedMutex::WaitFor(condition_variable& cv, chrono::nanoseconds timeout)
+{
+	Add(m_holdTicks, Elapsed(m_holdStart));
+
+	unique_lock<mutex> native(m_mutex, adopt_lock);
+	cv.wait_for(native, timeout);
+	native.release();
+
+	Acquired();
+}
+
+//----------------------------------------------------------------------------
+// GetStats
+//----------------------------------------------------------------------------
+InstrumentedMutex::Stats InstrumentedMutex::GetStats() const
+{
+	Stats stats;
+	stats.acquired = m_acquired.load(memory_order_relaxed);
+	stats.contended = m_contended.load(memory_order_relaxed);
+	stats.waitNs = TscClock::ToNanoseconds(m_waitTicks.load(memory_order_relaxed));
+	stats.holdNs = TscClock::ToNanoseconds(m_holdTicks.load(memory_order_relaxed));
+	return stats;
+}
@@ -0,0 +1,107 @@
+#ifndef _INSTRUMENTED_MUTEX_H
+#define _INSTRUMENTED_MUTEX_H
+
+// A std::mutex that measures its own contention.
+//
+// lock() first tries an uncontended acquire; only when that fails does it
+// time the blocking acquire. Hold time runs from acquire to unlock(). All
+// counters are written while the mutex is held, so they need no atomic
+// read-modify-write, and are stored in TscClock ticks until GetStats()
+// converts them. Usable with std::lock_guard and std::unique_lock; waits on a
+// condition variable go through Wait() so the time spent waiting is not
+// counted as hold time.
+
+#include "TscClock.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+class InstrumentedMutex
+{
+public:
+    struct Stats
+    {
+        uint64_t acquired;      ///< Successful lock() and try_lock() calls
+        uint64_t contended;     ///< Acquires that found the mutex held
+        uint64_t waitNs;        ///< Time spent blocked in contended acquires
+        uint64_t holdNs;        ///< Time the mutex was held
+    };
+
+    InstrumentedMutex() = default;
+
+    void lock()
+    {
+        if (!m_mutex.try_lock())
+        {
+            uint64_t start = TscClock::Now();
+            m_mutex.lock();
+            Add(m_waitTicks, Elapsed(start));
+            Add(m_contended, 1);
+        }
+        Acquired();
+    }
+
+    bool try_lock()
+    {
+        if (!m_mutex.try_lock())
+            return false;
+        Acquired();
+        return true;
+    }
+
+    void unlock()
+    {
+        Add(m_holdTicks, Elapsed(m_holdStart));
+        m_mutex.unlock();
+    }
+
+    /// Wait on a condition variable. The caller must hold the mutex.
+    /// @param[in] cv - the condition variable
+    void Wait(std::condition_variable& cv);
+
+    /// Wait on a condition variable for at most a timeout. The caller must
+    /// hold the mutex.
+    /// @param[in] cv - the condition variable
+    /// @param[in] timeout - the longest time to wait
+    void WaitFor(std::condition_variable& cv, std::chrono::nanoseconds timeout);
+
+    /// Read the counters. May be called from any thread; counters are
+    /// individually, not mutually, consistent.
+    /// @return The counters since construction
+    Stats GetStats() const;
+
+private:
+    InstrumentedMutex(const InstrumentedMutex&) = delete;
+    InstrumentedMutex& operator=(const InstrumentedMutex&) = delete;
+
+    void Acquired()
+    {
+        Add(m_acquired, 1);
+        m_holdStart = TscClock::Now();
+    }
+
+    /// Ticks since start, or 0 if the counter read behind it (e.g. unsynchronized
+    /// TSCs after a migration), so a negative delta cannot wrap the total
+    static uint64_t Elapsed(uint64_t start)
+    {
+        int64_t delta = static_cast<int64_t>(TscClock::Now() - start);
+        return delta > 0 ? static_cast<uint64_t>(delta) : 0;
+    }
+
+    /// Writers are serialized by m_mutex; only readers are concurrent
+    static void Add(std::atomic<uint64_t>& counter, uint64_t value)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    std::mutex m_mutex;
+    uint64_t m_holdStart = 0;
+    std::atomic<uint64_t> m_acquired{0};
+    std::atomic<uint64_t> m_contended{0};
+    std::atomic<uint64_t> m_waitTicks{0};
+    std::atomic<uint64_t> m_holdTicks{0};
+};
+
+#endif
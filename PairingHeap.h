@@ -0,0 +1,125 @@
+#ifndef _PAIRING_HEAP_H
+#define _PAIRING_HEAP_H
+
+// Min pairing heap. Push() and Top() are O(1); Pop() is O(log n) amortized
+// using the standard two-pass pairing. Nodes are allocated from BlockPool.
+
+#include "BlockPool.h"
+#include "Fault.h"
+#include <cstddef>
+#include <new>
+#include <utility>
+
+template <class T, class Less>
+class PairingHeap
+{
+public:
+    PairingHeap() = default;
+
+    ~PairingHeap()
+    {
+        while (!Empty())
+            Pop();
+    }
+
+    /// @return True if the heap has no elements
+    bool Empty() const { return m_root == nullptr; }
+
+    /// @return The number of elements
+    size_t Size() const { return m_size; }
+
+    /// Insert an element
+    /// @param[in] value - the element
+    void Push(T value)
+    {
+        void* mem = BlockPool::Allocate(sizeof(Node));
+        Node* node = new (mem) Node(std::move(value));
+        m_root = Meld(m_root, node);
+        m_size++;
+    }
+
+    /// @return The minimum element. The heap must not be empty.
+    const T& Top() const
+    {
+        ASSERT_TRUE(m_root != nullptr);
+        return m_root->value;
+    }
+
+    /// Remove and return the minimum element. The heap must not be empty.
+    /// @return The minimum element
+    T Pop()
+    {
+        ASSERT_TRUE(m_root != nullptr);
+        Node* root = m_root;
+        m_root = MergePairs(root->child);
+        m_size--;
+
+        T value = std::move(root->value);
+        root->~Node();
+        BlockPool::Deallocate(root, sizeof(Node));
+        return value;
+    }
+
+private:
+    PairingHeap(const PairingHeap&) = delete;
+    PairingHeap& operator=(const PairingHeap&) = delete;
+
+    struct Node
+    {
+        explicit Node(T v) : value(std::move(v)) {}
+        T value;
+        Node* child = nullptr;
+        Node* sibling = nullptr;
+    };
+
+    /// Link two roots; the larger becomes the leftmost child of the smaller
+    Node* Meld(Node* a, Node* b)
+    {
+        if (a == nullptr)
+            return b;
+        if (b == nullptr)
+            return a;
+        if (m_less(b->value, a->value))
+            std::swap(a, b);
+        b->sibling = a->child;
+        a->child = b;
+        return a;
+    }
+
+    /// Two-pass pairing of a sibling list: meld pairs left to right, then
+    /// meld the results right to left
+    Node* MergePairs(Node* first)
+    {
+        Node* paired = nullptr;
+        while (first)
+        {
+            Node* a = first;
+            Node* b = a->sibling;
+            first = b ? b->sibling : nullptr;
+            a->sibling = nullptr;
+            if (b)
+                b->sibling = nullptr;
+
+            // Reuse the sibling links to stack the pairs in reverse order
+            Node* pair = Meld(a, b);
+            pair->sibling = paired;
+            paired = pair;
+        }
+
+        Node* result = nullptr;
+        while (paired)
+        {
+            Node* next = paired->sibling;
+            paired->sibling = nullptr;
+            result = Meld(result, paired);
+            paired = next;
+        }
+        return result;
+    }
+
+    Node* m_root = nullptr;
+    size_t m_size = 0;
+    Less m_less;
+};
+
+#endif
@@ -0,0 +1,358 @@
+#include "Profiler.h"
+
+#ifdef __linux__
+
+#include "Fault.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cerrno>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <map>
+#include <mutex>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+#ifndef sigev_notify_thread_id
+#define sigev_notify_thread_id _sigev_un._tid
+#endif
+
+using namespace std;
+
+namespace
+{
+	const int MAX_FRAMES = 32;
+	const uint32_t RING_SIZE = 256;
+
+	// Frames for the signal handler and the kernel's signal trampoline
+	const int HANDLER_FRAMES = 2;
+
+	struct Sample
+	{
+		int msgId;
+		const char* tag;
+		int depth;
+		void* frames[MAX_FRAMES];
+	};
+
+	// Single producer (the signal handler on the owning thread), single
+	// consumer (the collector, under the registry lock)
+	struct ThreadRecord
+	{
+		string name;
+		pthread_t thread;
+		pid_t tid;
+		timer_t timer;
+		bool armed = false;
+		atomic<uint32_t> head{0};
+		atomic<uint32_t> tail{0};
+		Sample ring[RING_SIZE];
+	};
+
+	struct Registry
+	{
+		mutex lock;
+		condition_variable wake;
+		vector<ThreadRecord*> threads;
+		map<string, uint64_t> folded;
+		int hz = 0;
+		bool running = false;
+		thread collector;
+	};
+
+	// Never destroyed so worker threads may unregister during static destruction
+	Registry& GetRegistry()
+	{
+		static Registry* registry = new Registry();
+		return *registry;
+	}
+
+	atomic<uint64_t> s_dropped{0};
+
+	// Trivially initialized so the signal handler may read them
+	thread_local ThreadRecord* t_record = nullptr;
+	thread_local volatile int t_msgId = 0;
+	thread_local const char* volatile t_tag = nullptr;
+
+	void OnSignal(int, siginfo_t*, void*)
+	{
+		ThreadRecord* record = t_record;
+		if (record == nullptr)
+			return;
+
+		int savedErrno = errno;
+		uint32_t head = record->head.load(memory_order_relaxed);
+		if (head - record->tail.load(memory_order_acquire) >= RING_SIZE)
+		{
+			s_dropped.fetch_add(1, memory_order_relaxed);
+		}
+		else
+		{
+			Sample& sample = record->ring[head % RING_SIZE];
+			sample.msgId = t_msgId;
+			sample.tag = t_tag;
+			sample.depth = backtrace(sample.frames, MAX_FRAMES);
+			record->head.store(head + 1, memory_order_release);
+		}
+		errno = savedErrno;
+	}
+
+	string FrameName(void* address)
+	{
+		Dl_info info;
+		if (dladdr(address, &info) && info.dli_sname)
+		{
+			int status = 0;
+			char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+			string name = status == 0 && demangled ? demangled : info.dli_sname;
+			free(demangled);
+			return name;
+		}
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%p", address);
+		return buffer;
+	}
+
+	// Caller holds the registry lock
+	void Drain(Registry& registry, ThreadRecord* record)
+	{
+		uint32_t tail = record->tail.load(memory_order_relaxed);
+		uint32_t head = record->head.load(memory_order_acquire);
+		for (; tail != head; tail++)
+		{
+			const Sample& sample = record->ring[tail % RING_SIZE];
+
+			// Folded stacks list the root first; ';' separates frames
+			string message = sample.tag ? sample.tag : "msg_" + to_string(sample.msgId);
+			replace(message.begin(), message.end(), ';', ':');
+			string stack = record->name + ";" + message;
+			for (int f = sample.depth - 1; f >= HANDLER_FRAMES; f--)
+			{
+				string frame = FrameName(sample.frames[f]);
+				replace(frame.begin(), frame.end(), ';', ':');
+				stack += ";" + frame;
+			}
+			registry.folded[stack]++;
+		}
+		record->tail.store(tail, memory_order_release);
+	}
+
+	// Caller holds the registry lock
+	bool Arm(Registry& registry, ThreadRecord* record)
+	{
+		clockid_t clock;
+		if (pthread_getcpuclockid(record->thread, &clock) != 0)
+			return false;
+
+		sigevent event;
+		memset(&event, 0, sizeof(event));
+		event.sigev_notify = SIGEV_THREAD_ID;
+		event.sigev_signo = SIGPROF;
+		event.sigev_notify_thread_id = record->tid;
+		if (timer_create(clock, &event, &record->timer) != 0)
+			return false;
+
+		long period = 1000000000L / registry.hz;
+		itimerspec spec;
+		spec.it_interval.tv_sec = period / 1000000000L;
+		spec.it_interval.tv_nsec = period % 1000000000L;
+		spec.it_value = spec.it_interval;
+		if (timer_settime(record->timer, 0, &spec, nullptr) != 0)
+		{
+			timer_delete(record->timer);
+			return false;
+		}
+		record->armed = true;
+		return true;
+	}
+
+	// Caller holds the registry lock
+	void Disarm(ThreadRecord* record)
+	{
+		if (record->armed)
+			timer_delete(record->timer);
+		record->armed = false;
+	}
+
+	void Collect()
+	{
+		Registry& registry = GetRegistry();
+		unique_lock<mutex> lock(registry.lock);
+		while (registry.running)
+		{
+			registry.wake.wait_for(lock, chrono::milliseconds(100));
+			for (ThreadRecord* record : registry.threads)
+				Drain(registry, record);
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+// Start
+//----------------------------------------------------------------------------
+bool Profiler::Start(int hz)
+{
+	ASSERT_TRUE(hz > 0);
+
+	Registry& registry = GetRegistry();
+	lock_guard<mutex> lock(registry.lock);
+	if (registry.running)
+		return false;
+
+	// backtrace() loads the unwinder on first use, which is not safe in a
+	// signal handler, so warm it up here
+	void* warmup[1];
+	backtrace(warmup, 1);
+
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_sigaction = OnSignal;
+	action.sa_flags = SA_SIGINFO | SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	if (sigaction(SIGPROF, &action, nullptr) != 0)
+		return false;
+
+	registry.hz = hz;
+	registry.running = true;
+	for (ThreadRecord* record : registry.threads)
+		Arm(registry, record);
+	registry.collector = thread(Collect);
+	return true;
+}
+
+//----------------------------------------------------------------------------
+// Stop
+//----------------------------------------------------------------------------
+void Profiler::Stop()
+{
+	Registry& registry = GetRegistry();
+	{
+		lock_guard<mutex> lock(registry.lock);
+		if (!registry.running)
+			return;
+		registry.running = false;
+		for (ThreadRecord* record : registry.threads)
+			Disarm(record);
+		registry.wake.notify_one();
+	}
+	registry.collector.join();
+
+	lock_guard<mutex> lock(registry.lock);
+	for (ThreadRecord* record : registry.threads)
+		Drain(registry, record);
+}
+
+//----------------------------------------------------------------------------
+// Reset
+//----------------------------------------------------------------------------
+void Profiler::Reset()
+{
+	Registry& registry = GetRegistry();
+	lock_guard<mutex> lock(registry.lock);
+	registry.folded.clear();
+	s_dropped.store(0, memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// WriteFolded
+//----------------------------------------------------------------------------
+void Profiler::WriteFolded(ostream& os)
+{
+	Registry& registry = GetRegistry();
+	lock_guard<mutex> lock(registry.lock);
+	for (ThreadRecord* record : registry.threads)
+		Drain(registry, record);
+	for (const auto& entry : registry.folded)
+		os << entry.first << ' ' << entry.second << '\n';
+}
+
+//----------------------------------------------------------------------------
+// GetDroppedCount
+//----------------------------------------------------------------------------
+uint64_t Profiler::GetDroppedCount()
+{
+	return s_dropped.load(memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// RegisterThread
+//----------------------------------------------------------------------------
+void Profiler::RegisterThread(const string& name)
+{
+	ASSERT_TRUE(t_record == nullptr);
+
+	ThreadRecord* record = new ThreadRecord();
+	record->name = name;
+	replace(record->name.begin(), record->name.end(), ';', ':');
+	record->thread = pthread_self();
+	record->tid = static_cast<pid_t>(syscall(SYS_gettid));
+
+	Registry& registry = GetRegistry();
+	lock_guard<mutex> lock(registry.lock);
+	registry.threads.push_back(record);
+	t_record = record;
+	if (registry.running)
+		Arm(registry, record);
+}
+
+//----------------------------------------------------------------------------
+// UnregisterThread
+//----------------------------------------------------------------------------
+void Profiler::UnregisterThread()
+{
+	ThreadRecord* record = t_record;
+	if (record == nullptr)
+		return;
+
+	// A signal still pending after the timer is deleted finds no record
+	t_record = nullptr;
+
+	Registry& registry = GetRegistry();
+	lock_guard<mutex> lock(registry.lock);
+	Disarm(record);
+	Drain(registry, record);
+	registry.threads.erase(find(registry.threads.begin(), registry.threads.end(), record));
+	delete record;
+}
+
+//----------------------------------------------------------------------------
+// SetCurrentMessage
+//----------------------------------------------------------------------------
+void Profiler::SetCurrentMessage(int id)
+{
+	t_msgId = id;
+	t_tag = nullptr;
+}
+
+//----------------------------------------------------------------------------
+// SetMessageTag
+//----------------------------------------------------------------------------
+void Profiler::SetMessageTag(const char* tag)
+{
+	t_tag = tag;
+}
+
+#else
+
+bool Profiler::Start(int) { return false; }
+void Profiler::Stop() {}
+void Profiler::Reset() {}
+void Profiler::WriteFolded(std::ostream&) {}
+uint64_t Profiler::GetDroppedCount() { return 0; }
+void Profiler::RegisterThread(const std::string&) {}
+void Profiler::UnregisterThread() {}
+void Profiler::SetCurrentMessage(int) {}
+void Profiler::SetMessageTag(const char*) {}
+
+#endif
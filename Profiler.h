@@ -0,0 +1,65 @@
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+// In-process sampling profiler for WorkerThreads.
+//
+// Each registered worker thread gets a per-thread CPU time timer that raises
+// SIGPROF on that thread. The signal handler records the worker's current
+// message id and a stack into a preallocated per-thread ring; a collector
+// thread drains the rings and aggregates identical stacks. WriteFolded()
+// emits one "worker;msg_<id>;frame;...;frame count" line per stack, the
+// folded format consumed by flamegraph.pl and speedscope. A handler that
+// calls SetMessageTag() replaces msg_<id> with its own message type name. Link executables
+// with -rdynamic so frames resolve to function names.
+//
+// Linux only. On other platforms Start() returns false and the other
+// functions do nothing.
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+class Profiler
+{
+public:
+    /// Default sampling rate. Off the round numbers so samples do not alias
+    /// with periodic work.
+    static const int DEFAULT_HZ = 99;
+
+    /// Start sampling all registered threads and any registered later
+    /// @param[in] hz - samples per second of thread CPU time
+    /// @return False if unsupported or already started
+    static bool Start(int hz = DEFAULT_HZ);
+
+    /// Stop sampling. Collected samples are kept until Reset().
+    static void Stop();
+
+    /// Discard collected samples
+    static void Reset();
+
+    /// Write collected samples in folded stack format
+    /// @param[in] os - the output stream
+    static void WriteFolded(std::ostream& os);
+
+    /// @return The number of samples lost because a ring was full
+    static uint64_t GetDroppedCount();
+
+    /// Register the calling thread for sampling. Called by WorkerThread.
+    /// @param[in] name - the name used as the root frame
+    static void RegisterThread(const std::string& name);
+
+    /// Unregister the calling thread. Called by WorkerThread at exit.
+    static void UnregisterThread();
+
+    /// Set the message id the calling thread is dispatching
+    /// @param[in] id - the message id, -1 for a work item, 0 when idle
+    static void SetCurrentMessage(int id);
+
+    /// Name the message type the calling thread is handling, so its samples
+    /// are attributed to the tag instead of the internal message id. Call from
+    /// a handler or task; the tag is cleared when the dispatch ends.
+    /// @param[in] tag - a string with static storage duration, e.g. a literal
+    static void SetMessageTag(const char* tag);
+};
+
+#endif
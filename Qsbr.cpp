@@ -0,0 +1,136 @@
+#include "Qsbr.h"
+#include "Fault.h"
+#include <algorithm>
+
+using namespace std;
+
+//----------------------------------------------------------------------------
+// Instance
+//----------------------------------------------------------------------------
+Qsbr& Qsbr::Instance()
+{
+	// Intentionally never destroyed so worker threads exiting during static
+	// destruction can still unregister
+	static Qsbr* instance = new Qsbr();
+	return *instance;
+}
+
+//----------------------------------------------------------------------------
+// Register
+//----------------------------------------------------------------------------
+void Qsbr::Register(ThreadRecord* record)
+{
+	ASSERT_TRUE(record != nullptr);
+
+	lock_guard<mutex> lock(m_mutex);
+	ASSERT_TRUE(find(m_records.begin(), m_records.end(), record) == m_records.end());
+	m_records.push_back(record);
+	Online(record);
+}
+
+//----------------------------------------------------------------------------
+// Unregister
+//----------------------------------------------------------------------------
+void Qsbr::Unregister(ThreadRecord* record)
+{
+	vector<Retired> expired;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		Offline(record);
+		m_records.erase(remove(m_records.begin(), m_records.end(), record), m_records.end());
+		CollectExpired(expired);
+	}
+
+	for (auto& r : expired)
+		r.deleter(r.ptr);
+}
+
+//----------------------------------------------------------------------------
+// Retire
+//----------------------------------------------------------------------------
+void Qsbr::Retire(void* ptr, void (*deleter)(void*))
+{
+	ASSERT_TRUE(ptr != nullptr && deleter != nullptr);
+
+	vector<Retired> expired;
+	{
+		lock_guard<mutex> lock(m_mutex);
+
+		// Readers that observe the new epoch at a quiescent state can no
+		// longer reach the object unlinked before this increment
+		uint64_t epoch = m_epoch.fetch_add(1, memory_order_seq_cst) + 1;
+		m_retired.push_back({ ptr, deleter, epoch });
+		m_pendingCount.fetch_add(1, memory_order_relaxed);
+		if (m_retired.size() == 1)
+			m_oldestPending.store(epoch, memory_order_relaxed);
+
+		CollectExpired(expired);
+	}
+
+	for (auto& r : expired)
+		r.deleter(r.ptr);
+}
+
+//----------------------------------------------------------------------------
+// Reclaim
+//----------------------------------------------------------------------------
+size_t Qsbr::Reclaim()
+{
+	vector<Retired> expired;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		CollectExpired(expired);
+	}
+
+	for (auto& r : expired)
+		r.deleter(r.ptr);
+	return expired.size();
+}
+
+//----------------------------------------------------------------------------
+// TryReclaim
+//----------------------------------------------------------------------------
+void Qsbr::TryReclaim()
+{
+	vector<Retired> expired;
+	{
+		unique_lock<mutex> lock(m_mutex, try_to_lock);
+		if (!lock.owns_lock())
+			return;
+		CollectExpired(expired);
+	}
+
+	for (auto& r : expired)
+		r.deleter(r.ptr);
+}
+
+//----------------------------------------------------------------------------
+// CollectExpired
+//----------------------------------------------------------------------------
+void Qsbr::CollectExpired(vector<Retired>& expired)
+{
+	if (m_retired.empty())
+		return;
+
+	// The grace period has elapsed for every object retired at or before the
+	// oldest epoch reported by an online reader
+	uint64_t minEpoch = UINT64_MAX;
+	for (ThreadRecord* record : m_records)
+	{
+		uint64_t epoch = record->epoch.load(memory_order_seq_cst);
+		if (epoch != 0 && epoch < minEpoch)
+			minEpoch = epoch;
+	}
+
+	// m_retired is ordered by epoch
+	auto it = m_retired.begin();
+	while (it != m_retired.end() && it->epoch <= minEpoch)
+		++it;
+	if (it == m_retired.begin())
+		return;
+
+	expired.assign(m_retired.begin(), it);
+	m_retired.erase(m_retired.begin(), it);
+	m_pendingCount.fetch_sub(expired.size(), memory_order_relaxed);
+	m_oldestPending.store(m_retired.empty() ? UINT64_MAX : m_retired.front().epoch, memory_order_relaxed);
+}
@@ -0,0 +1,157 @@
+#ifndef _QSBR_H
+#define _QSBR_H
+
+// Quiescent-state-based reclamation (QSBR) for data shared between WorkerThreads.
+//
+// Each WorkerThread reports a quiescent state between message dispatches. A
+// handler never holds a reference into RCU protected data across a message
+// boundary, so once every online worker has reported a quiescent state after
+// an object was retired, no reader can still reference it and it is deleted.
+// Readers pay one acquire load per pointer access; no locks, no reference counts.
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class Qsbr
+{
+public:
+    /// Per-thread quiescent state record. Owned by the reporting thread.
+    struct ThreadRecord
+    {
+        /// Last global epoch observed at a quiescent state. 0 if offline.
+        std::atomic<uint64_t> epoch{0};
+    };
+
+    /// Get the process wide QSBR domain
+    /// @return The QSBR domain instance
+    static Qsbr& Instance();
+
+    /// Register the calling thread as a reader. The thread starts online.
+    /// @param[in] record - the calling thread's record
+    void Register(ThreadRecord* record);
+
+    /// Unregister the calling thread. Must not hold RCU references.
+    /// @param[in] record - the calling thread's record
+    void Unregister(ThreadRecord* record);
+
+    /// Report that the calling thread holds no RCU references. Called by
+    /// WorkerThread::Process() after each message dispatch.
+    /// @param[in] record - the calling thread's record
+    void QuiescentState(ThreadRecord* record)
+    {
+        uint64_t epoch = m_epoch.load(std::memory_order_acquire);
+        if (record->epoch.load(std::memory_order_relaxed) != epoch)
+        {
+            record->epoch.store(epoch, std::memory_order_release);
+
+            // Order the store before any subsequent RCU pointer loads
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+
+        if (m_pendingCount.load(std::memory_order_relaxed) != 0 &&
+            epoch >= m_oldestPending.load(std::memory_order_relaxed))
+            TryReclaim();
+    }
+
+    /// Enter an extended quiescent state, e.g. while blocked waiting for messages
+    /// @param[in] record - the calling thread's record
+    void Offline(ThreadRecord* record)
+    {
+        record->epoch.store(0, std::memory_order_release);
+    }
+
+    /// Leave an extended quiescent state before reading RCU protected data
+    /// @param[in] record - the calling thread's record
+    void Online(ThreadRecord* record)
+    {
+        record->epoch.store(m_epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    /// Defer deletion of an object until all readers pass a grace period. The
+    /// object must already be unreachable for new readers.
+    /// @param[in] ptr - the object to reclaim
+    /// @param[in] deleter - function that destroys the object
+    void Retire(void* ptr, void (*deleter)(void*));
+
+    /// Defer deletion of an object allocated with new
+    /// @param[in] ptr - the object to reclaim
+    template <class T>
+    void Retire(T* ptr)
+    {
+        Retire(const_cast<void*>(static_cast<const void*>(ptr)), [](void* p) { delete static_cast<T*>(p); });
+    }
+
+    /// Delete all retired objects whose grace period has elapsed
+    /// @return The number of objects deleted
+    size_t Reclaim();
+
+    /// Get the number of retired objects waiting for a grace period
+    /// @return The pending object count
+    size_t GetPendingCount() const { return m_pendingCount.load(std::memory_order_relaxed); }
+
+private:
+    Qsbr() = default;
+    Qsbr(const Qsbr&) = delete;
+    Qsbr& operator=(const Qsbr&) = delete;
+
+    struct Retired
+    {
+        void* ptr;
+        void (*deleter)(void*);
+        uint64_t epoch;
+    };
+
+    /// Reclaim from a worker thread without waiting on another reclaimer
+    void TryReclaim();
+
+    /// Remove retired objects whose grace period elapsed. Caller must hold m_mutex.
+    /// @param[out] expired - objects to delete once m_mutex is released
+    void CollectExpired(std::vector<Retired>& expired);
+
+    std::atomic<uint64_t> m_epoch{1};
+    std::atomic<size_t> m_pendingCount{0};
+    std::atomic<uint64_t> m_oldestPending{UINT64_MAX};
+    std::mutex m_mutex;
+    std::vector<ThreadRecord*> m_records;
+    std::vector<Retired> m_retired;
+};
+
+/// Pointer to read-mostly data shared between WorkerThreads. Readers running
+/// inside a WorkerThread message handler call Load(); writers publish a new
+/// version with Update() and the old version is reclaimed after a grace period.
+template <class T>
+class RcuPtr
+{
+public:
+    RcuPtr() = default;
+    explicit RcuPtr(T* ptr) : m_ptr(ptr) {}
+
+    /// Delete the current version. No readers may remain.
+    ~RcuPtr() { delete m_ptr.load(std::memory_order_relaxed); }
+
+    /// Get the current version. Only valid on a registered worker thread and
+    /// only until the current message handler returns.
+    /// @return The current version, or nullptr
+    T* Load() const { return m_ptr.load(std::memory_order_acquire); }
+
+    /// Publish a new version and retire the previous one
+    /// @param[in] ptr - the new version allocated with new
+    void Update(T* ptr)
+    {
+        T* old = m_ptr.exchange(ptr, std::memory_order_seq_cst);
+        if (old)
+            Qsbr::Instance().Retire(old);
+    }
+
+private:
+    RcuPtr(const RcuPtr&) = delete;
+    RcuPtr& operator=(const RcuPtr&) = delete;
+
+    std::atomic<T*> m_ptr{nullptr};
+};
+
+#endif
@@ -0,0 +1,206 @@
+#include "ReferenceWorkerThread.h"
+#include "Fault.h"
+#include <iostream>
+
+#ifdef WIN32
+#include <Windows.h>
+#endif
+
+using namespace std;
+
+#define MSG_EXIT_THREAD			1
+#define MSG_POST_USER_DATA		2
+#define MSG_TIMER				3
+#define MSG_TASK				4
+
+struct ReferenceThreadMsg
+{
+	ReferenceThreadMsg(int i, std::shared_ptr<void> m) { id = i; msg = m; }
+	int id;
+	std::shared_ptr<void> msg;
+};
+
+//----------------------------------------------------------------------------
+// ReferenceWorkerThread
+//----------------------------------------------------------------------------
+ReferenceWorkerThread::ReferenceWorkerThread(const std::string& threadName) : m_thread(nullptr), m_timerExit(false), THREAD_NAME(threadName)
+{
+}
+
+//----------------------------------------------------------------------------
+// ~ReferenceWorkerThread
+//----------------------------------------------------------------------------
+ReferenceWorkerThread::~ReferenceWorkerThread()
+{
+	ExitThread();
+}
+
+//----------------------------------------------------------------------------
+// CreateThread
+//----------------------------------------------------------------------------
+bool ReferenceWorkerThread::CreateThread()
+{
+	if (!m_thread)
+	{
+		m_thread = std::unique_ptr<std::thread>(new thread(&ReferenceWorkerThread::Process, this));
+
+#ifdef WIN32
+		// Get the thread's native Windows handle
+		auto handle = m_thread->native_handle();
+
+		// Set the thread name so it shows in the Visual Studio Debug Location toolbar
+		std::wstring wstr(THREAD_NAME.begin(), THREAD_NAME.end());
+		HRESULT hr = SetThreadDescription(handle, wstr.c_str());
+		if (FAILED(hr))
+		{
+			// Handle error if needed
+		}
+#endif
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------------------
+// GetThreadId
+//----------------------------------------------------------------------------
+std::thread::id ReferenceWorkerThread::GetThreadId()
+{
+	ASSERT_TRUE(m_thread != nullptr);
+	return m_thread->get_id();
+}
+
+//----------------------------------------------------------------------------
+// ExitThread
+//----------------------------------------------------------------------------
+void ReferenceWorkerThread::ExitThread()
+{
+	if (!m_thread)
+		return;
+
+	// Create a new ThreadMsg
+	std::shared_ptr<ReferenceThreadMsg> threadMsg(new ReferenceThreadMsg(MSG_EXIT_THREAD, 0));
+
+	// Put exit thread message into the queue
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_queue.push(threadMsg);
+		m_cv.notify_one();
+	}
+
+	m_thread->join();
+	m_thread = nullptr;
+}
+
+//----------------------------------------------------------------------------
+// PostMsg
+//----------------------------------------------------------------------------
+void ReferenceWorkerThread::PostMsg(std::shared_ptr<UserData> data)
+{
+	ASSERT_TRUE(m_thread);
+
+	// Create a new ThreadMsg
+	std::shared_ptr<ReferenceThreadMsg> threadMsg(new ReferenceThreadMsg(MSG_POST_USER_DATA, data));
+
+	// Add user data msg to queue and notify worker thread
+	std::unique_lock<std::mutex> lk(m_mutex);
+	m_queue.push(threadMsg);
+	m_cv.notify_one();
+}
+
+//----------------------------------------------------------------------------
+// PostTask
+//----------------------------------------------------------------------------
+void ReferenceWorkerThread::PostTask(std::function<void()> task)
+{
+	ASSERT_TRUE(m_thread);
+
+	// Create a new ThreadMsg
+	std::shared_ptr<ReferenceThreadMsg> threadMsg(new ReferenceThreadMsg(MSG_TASK, std::make_shared<std::function<void()>>(std::move(task))));
+
+	// Add task msg to queue and notify worker thread
+	std::unique_lock<std::mutex> lk(m_mutex);
+	m_queue.push(threadMsg);
+	m_cv.notify_one();
+}
+
+//----------------------------------------------------------------------------
+// TimerThread
+//----------------------------------------------------------------------------
+void ReferenceWorkerThread::TimerThread()
+{
+	while (!m_timerExit)
+	{
+		// Sleep for 250mS then put a MSG_TIMER into the message queue
+		std::this_thread::sleep_for(250ms);
+
+		std::shared_ptr<ReferenceThreadMsg> threadMsg(new ReferenceThreadMsg(MSG_TIMER, 0));
+
+		// Add timer msg to queue and notify worker thread
+		std::unique_lock<std::mutex> lk(m_mutex);
+		m_queue.push(threadMsg);
+		m_cv.notify_one();
+	}
+}
+
+//----------------------------------------------------------------------------
+// Process
+//----------------------------------------------------------------------------
+void ReferenceWorkerThread::Process()
+{
+	m_timerExit = false;
+	std::thread timerThread(&ReferenceWorkerThread::TimerThread, this);
+
+	while (1)
+	{
+		std::shared_ptr<ReferenceThreadMsg> msg;
+		{
+			// Wait for a message to be added to the queue
+			std::unique_lock<std::mutex> lk(m_mutex);
+			while (m_queue.empty())
+				m_cv.wait(lk);
+
+			if (m_queue.empty())
+				continue;
+
+			msg = m_queue.front();
+			m_queue.pop();
+		}
+
+		switch (msg->id)
+		{
+			case MSG_POST_USER_DATA:
+			{
+				ASSERT_TRUE(msg->msg != NULL);
+
+				auto userData = std::static_pointer_cast<UserData>(msg->msg);
+				cout << userData->msg.c_str() << " " << userData->year << " on " << THREAD_NAME << endl;
+
+				break;
+			}
+
+			case MSG_TASK:
+			{
+				ASSERT_TRUE(msg->msg != NULL);
+
+				auto task = std::static_pointer_cast<std::function<void()>>(msg->msg);
+				(*task)();
+				break;
+			}
+
+			case MSG_TIMER:
+				cout << "Timer expired on " << THREAD_NAME << endl;
+				break;
+
+			case MSG_EXIT_THREAD:
+			{
+				m_timerExit = true;
+				timerThread.join();
+				return;
+			}
+
+			default:
+				ASSERT();
+		}
+	}
+}
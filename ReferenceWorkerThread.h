@@ -0,0 +1,69 @@
+#ifndef _REFERENCE_WORKER_THREAD_H
+#define _REFERENCE_WORKER_THREAD_H
+
+// The original WorkerThread design kept as a fixed baseline for A/B
+// benchmarks: one std::queue of shared_ptr messages guarded by a mutex, a
+// condition variable wakeup per post, and a 250ms timer thread. Do not
+// optimize this class; improvements belong in WorkerThread and are measured
+// against it. PostTask() is the only addition, so both classes can run the
+// same workloads.
+
+#include <thread>
+#include <queue>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <string>
+#include <functional>
+#include <memory>
+#include "WorkerThread.h"
+
+struct ReferenceThreadMsg;
+
+class ReferenceWorkerThread
+{
+public:
+    /// Constructor
+    ReferenceWorkerThread(const std::string& threadName);
+
+    /// Destructor
+    ~ReferenceWorkerThread();
+
+    /// Called once to create the worker thread
+    /// @return True if thread is created. False otherwise.
+    bool CreateThread();
+
+    /// Called once a program exit to exit the worker thread
+    void ExitThread();
+
+    /// Get the ID of this thread instance
+    /// @return The worker thread ID
+    std::thread::id GetThreadId();
+
+    /// Add a message to the thread queue
+    /// @param[in] data - thread specific message information
+    void PostMsg(std::shared_ptr<UserData> msg);
+
+    /// Add a function to the thread queue to be invoked on the worker thread
+    /// @param[in] task - the function to invoke
+    void PostTask(std::function<void()> task);
+
+private:
+    ReferenceWorkerThread(const ReferenceWorkerThread&) = delete;
+    ReferenceWorkerThread& operator=(const ReferenceWorkerThread&) = delete;
+
+    /// Entry point for the worker thread
+    void Process();
+
+    /// Entry point for timer thread
+    void TimerThread();
+
+    std::unique_ptr<std::thread> m_thread;
+    std::queue<std::shared_ptr<ReferenceThreadMsg>> m_queue;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::atomic<bool> m_timerExit;
+    const std::string THREAD_NAME;
+};
+
+#endif
@@ -0,0 +1,263 @@
+#include "SpillFile.h"
+#include "Fault.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef WIN32
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#include <cstdlib>
+#endif
+
+using namespace std;
+
+namespace
+{
+	// Records are a length prefix followed by the bytes, padded to 8
+	const size_t RECORD_ALIGN = 8;
+
+	size_t RecordSize(size_t size)
+	{
+		return (sizeof(uint32_t) + size + RECORD_ALIGN - 1) & ~(RECORD_ALIGN - 1);
+	}
+}
+
+//----------------------------------------------------------------------------
+// SpillFile
+//----------------------------------------------------------------------------
+SpillFile::SpillFile() :
+#ifdef WIN32
+	m_file(INVALID_HANDLE_VALUE), m_mapping(nullptr),
+#else
+	m_fd(-1),
+#endif
+	m_base(nullptr), m_capacity(0), m_maxCapacity(0), m_readOffset(0), m_writeOffset(0), m_releasedOffset(0),
+	m_wrapOffset(0), m_wrapped(false)
+{
+}
+
+//----------------------------------------------------------------------------
+// ~SpillFile
+//----------------------------------------------------------------------------
+SpillFile::~SpillFile()
+{
+	Unmap();
+#ifdef WIN32
+	if (m_file != INVALID_HANDLE_VALUE)
+		CloseHandle(m_file);
+#else
+	if (m_fd >= 0)
+		close(m_fd);
+#endif
+}
+
+//----------------------------------------------------------------------------
+// Open
+//----------------------------------------------------------------------------
+bool SpillFile::Open(const string& directory, size_t maxCapacity)
+{
+	ASSERT_TRUE(m_capacity == 0);
+	ASSERT_TRUE(maxCapacity >= INITIAL_CAPACITY);
+	m_maxCapacity = maxCapacity;
+
+#ifdef WIN32
+	char path[MAX_PATH];
+	if (GetTempFileNameA(directory.c_str(), "wts", 0, path) == 0)
+		return false;
+	m_file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+		return false;
+#else
+	string path = directory + "/WorkerThreadSpillXXXXXX";
+	m_fd = mkstemp(&path[0]);
+	if (m_fd < 0)
+		return false;
+	unlink(path.c_str());
+#endif
+
+	return Remap(INITIAL_CAPACITY);
+}
+
+//----------------------------------------------------------------------------
+// Write
+//----------------------------------------------------------------------------
+bool SpillFile::Write(const void* data, size_t size)
+{
+	ASSERT_TRUE(size <= UINT32_MAX);
+
+	size_t record = RecordSize(size);
+
+	// At the end, reuse the consumed front once it is at least half the file
+	if (!m_wrapped && m_writeOffset + record > m_capacity && m_readOffset >= m_capacity / 2 &&
+		record <= m_readOffset)
+	{
+		m_wrapOffset = m_writeOffset;
+		m_writeOffset = 0;
+		m_wrapped = true;
+	}
+
+	size_t limit = m_wrapped ? m_readOffset : m_capacity;
+	if (m_writeOffset + record > limit && !Grow(record))
+		return false;
+
+	uint32_t length = static_cast<uint32_t>(size);
+	memcpy(m_base + m_writeOffset, &length, sizeof(length));
+	memcpy(m_base + m_writeOffset + sizeof(length), data, size);
+	m_writeOffset += record;
+	return true;
+}
+
+//----------------------------------------------------------------------------
+// Grow
+//----------------------------------------------------------------------------
+bool SpillFile::Grow(size_t record)
+{
+	// Unwrapping appends the front segment after the tail
+	size_t needed = (m_wrapped ? m_wrapOffset + m_writeOffset : m_writeOffset) + record;
+	if (needed > m_maxCapacity)
+		return false;
+	if (needed > m_capacity)
+	{
+		size_t capacity = (m_capacity > INITIAL_CAPACITY ? m_capacity : INITIAL_CAPACITY) * 2;
+		while (capacity < needed)
+			capacity *= 2;
+		if (!Remap(min(capacity, m_maxCapacity)))
+			return false;
+	}
+
+	if (m_wrapped)
+	{
+		memcpy(m_base + m_wrapOffset, m_base, m_writeOffset);
+		m_writeOffset += m_wrapOffset;
+		m_wrapped = false;
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------
+// Read
+//----------------------------------------------------------------------------
+void SpillFile::Read(string& record)
+{
+	ASSERT_TRUE(!Empty());
+
+	// Follow the writer back to the front
+	if (m_wrapped && m_readOffset == m_wrapOffset)
+	{
+		ReleaseConsumed(m_wrapOffset);
+		m_readOffset = m_releasedOffset = 0;
+		m_wrapped = false;
+	}
+
+	uint32_t length;
+	memcpy(&length, m_base + m_readOffset, sizeof(length));
+	record.assign(m_base + m_readOffset + sizeof(length), length);
+	m_readOffset += RecordSize(length);
+
+	if (Empty())
+	{
+		// Drained. Start over and give back any growth, or at least the
+		// pages if the smaller view cannot be mapped.
+		m_readOffset = m_writeOffset = m_releasedOffset = 0;
+		if (m_capacity <= INITIAL_CAPACITY || !Remap(INITIAL_CAPACITY))
+			ReleaseConsumed(m_capacity);
+		m_releasedOffset = 0;
+	}
+	else if (m_readOffset - m_releasedOffset >= RELEASE_STRIDE)
+	{
+		ReleaseConsumed(m_readOffset);
+	}
+}
+
+//----------------------------------------------------------------------------
+// ReleaseConsumed
+//----------------------------------------------------------------------------
+void SpillFile::ReleaseConsumed(size_t end)
+{
+#ifdef WIN32
+	size_t pageSize = 4096;
+#else
+	size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+	// Pages are shared with the file, so a page the wrapped writer has
+	// already reused is only dropped from memory, not lost
+	size_t begin = m_releasedOffset & ~(pageSize - 1);
+	end &= ~(pageSize - 1);
+	if (end <= begin)
+		return;
+
+#ifdef WIN32
+	// Unlocking pages that are not locked removes them from the working set
+	VirtualUnlock(m_base + begin, end - begin);
+#else
+	madvise(m_base + begin, end - begin, MADV_DONTNEED);
+#endif
+	m_releasedOffset = end;
+}
+
+//----------------------------------------------------------------------------
+// Remap
+//----------------------------------------------------------------------------
+bool SpillFile::Remap(size_t capacity)
+{
+	// The new view is mapped before the old one is dropped, so a failure
+	// leaves the file usable at its current size. Shrinking only happens
+	// once drained.
+	bool shrink = capacity < m_capacity;
+
+#ifdef WIN32
+	// A mapping larger than the file extends it. A file with a view open
+	// cannot be truncated, so a shrink only maps less of it.
+	LARGE_INTEGER size;
+	size.QuadPart = static_cast<LONGLONG>(capacity);
+	HANDLE mapping = CreateFileMappingA(m_file, nullptr, PAGE_READWRITE, size.HighPart, size.LowPart, nullptr);
+	if (mapping == nullptr)
+		return false;
+	char* base = static_cast<char*>(MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, capacity));
+	if (base == nullptr)
+	{
+		CloseHandle(mapping);
+		return false;
+	}
+	Unmap();
+	m_mapping = mapping;
+#else
+	if (!shrink && ftruncate(m_fd, static_cast<off_t>(capacity)) != 0)
+		return false;
+	void* mapped = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+	if (mapped == MAP_FAILED)
+		return false;
+	char* base = static_cast<char*>(mapped);
+	Unmap();
+
+	// Nothing beyond the new view is in use, so a failed truncate only
+	// leaves the file larger than needed
+	if (shrink)
+		(void)ftruncate(m_fd, static_cast<off_t>(capacity));
+#endif
+
+	m_base = base;
+	m_capacity = capacity;
+	return true;
+}
+
+//----------------------------------------------------------------------------
+// Unmap
+//----------------------------------------------------------------------------
+void SpillFile::Unmap()
+{
+#ifdef WIN32
+	if (m_base)
+		UnmapViewOfFile(m_base);
+	if (m_mapping)
+		CloseHandle(m_mapping);
+	m_mapping = nullptr;
+#else
+	if (m_base)
+		munmap(m_base, m_capacity);
+#endif
+	m_base = nullptr;
+}
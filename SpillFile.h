@@ -0,0 +1,98 @@
+#ifndef _SPILL_FILE_H
+#define _SPILL_FILE_H
+
+// Memory-mapped FIFO of byte records backed by a temporary file.
+//
+// Records are appended at the write offset and consumed from the read offset.
+// The file is a ring: once the writer reaches the end and the reader has
+// consumed at least half the file, writing wraps to the front, so a sustained
+// backlog reuses consumed space instead of growing the file. Otherwise the
+// mapping grows by doubling, up to a maximum size; Write() fails once the
+// maximum is reached. Consumed pages are released from the process as the
+// reader advances, and once the reader catches up the file shrinks back to
+// its initial size, so a burst leaves no lasting footprint in memory or on
+// disk. Not thread-safe; the owner serializes access.
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class SpillFile
+{
+public:
+    SpillFile();
+    ~SpillFile();
+
+    /// Create the backing file. It is removed from the directory immediately
+    /// (POSIX) or on close (Windows).
+    /// @param[in] directory - the directory to create the file in
+    /// @param[in] maxCapacity - the largest size the file may grow to
+    /// @return True if the file was created and mapped
+    bool Open(const std::string& directory, size_t maxCapacity = DEFAULT_MAX_CAPACITY);
+
+    /// Append a record
+    /// @param[in] data - the record bytes
+    /// @param[in] size - the number of bytes
+    /// @return False if the file is at its maximum size or could not grow
+    bool Write(const void* data, size_t size);
+
+    /// Remove the oldest record. The file must not be empty.
+    /// @param[out] record - receives the record bytes
+    void Read(std::string& record);
+
+    /// @return True if there are no unread records
+    bool Empty() const { return m_readOffset == m_writeOffset && !m_wrapped; }
+
+    /// Default maximum file size
+    static const size_t DEFAULT_MAX_CAPACITY = 1024ull * 1024 * 1024;
+
+    /// @return The current size of the backing file in bytes
+    size_t GetCapacity() const { return m_capacity; }
+
+private:
+    SpillFile(const SpillFile&) = delete;
+    SpillFile& operator=(const SpillFile&) = delete;
+
+    /// Resize the backing file and remap it
+    /// @param[in] capacity - the new size in bytes
+    /// @return True on success
+    bool Remap(size_t capacity);
+
+    /// Make room for a record at the write offset by growing the file, and
+    /// unwrap the ring so unread records are contiguous again
+    /// @param[in] record - the padded record size
+    /// @return False if the maximum size would be exceeded or growth failed
+    bool Grow(size_t record);
+
+    /// Unmap the backing file
+    void Unmap();
+
+    /// Return consumed whole pages below an offset to the system
+    /// @param[in] end - the end of the consumed range
+    void ReleaseConsumed(size_t end);
+
+    static const size_t INITIAL_CAPACITY = 1024 * 1024;
+
+    /// Consumed bytes that accumulate before pages are released
+    static const size_t RELEASE_STRIDE = 1024 * 1024;
+
+#ifdef WIN32
+    void* m_file;
+    void* m_mapping;
+#else
+    int m_fd;
+#endif
+    char* m_base;
+    size_t m_capacity;
+    size_t m_maxCapacity;
+    size_t m_readOffset;
+    size_t m_writeOffset;
+    size_t m_releasedOffset;
+
+    /// While wrapped, unread records run from the read offset to the wrap
+    /// offset, then from the front to the write offset
+    size_t m_wrapOffset;
+    bool m_wrapped;
+};
+
+#endif
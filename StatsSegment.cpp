@@ -0,0 +1,382 @@
+#include "StatsSegment.h"
+#include "Fault.h"
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#ifdef WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static_assert(atomic<uint64_t>::is_always_lock_free, "Shared-memory counters must be lock-free");
+
+namespace
+{
+	// Slots start on their own cache line after the header
+	const size_t SLOTS_OFFSET = 64;
+
+	// A publish takes well under a microsecond; a slot still mid-write after
+	// this many yields belongs to a writer that died holding it
+	const int READ_RETRIES = 1000;
+
+	// The segment WorkerThreads publish into, set by Create()
+	StatsSegment*& ProcessSegment()
+	{
+		static StatsSegment* segment = nullptr;
+		return segment;
+	}
+}
+
+//----------------------------------------------------------------------------
+// WaitWindow::Record
+//----------------------------------------------------------------------------
+void WaitWindow::Record(uint64_t ticks)
+{
+	size_t index;
+	if (ticks < 4)
+	{
+		index = static_cast<size_t>(ticks);
+	}
+	else
+	{
+		unsigned msb = static_cast<unsigned>(bit_width(ticks)) - 1;
+		index = msb * 4 + static_cast<size_t>((ticks >> (msb - 2)) & 3);
+	}
+	m_counts[index]++;
+	m_count++;
+}
+
+//----------------------------------------------------------------------------
+// WaitWindow::Percentile
+//----------------------------------------------------------------------------
+uint64_t WaitWindow::Percentile(double percentile) const
+{
+	if (m_count == 0)
+		return 0;
+	uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(m_count) + 0.5);
+	if (rank < 1)
+		rank = 1;
+
+	uint64_t seen = 0;
+	for (size_t i = 0; i < BUCKETS; i++)
+	{
+		seen += m_counts[i];
+		if (seen < rank)
+			continue;
+		if (i < 4)
+			return i;
+		unsigned msb = static_cast<unsigned>(i / 4);
+		uint64_t lower = (4 + (i & 3)) << (msb - 2);
+		return lower + (1ull << (msb - 2)) - 1;
+	}
+	return UINT64_MAX;
+}
+
+//----------------------------------------------------------------------------
+// WaitWindow::Reset
+//----------------------------------------------------------------------------
+void WaitWindow::Reset()
+{
+	memset(m_counts, 0, sizeof(m_counts));
+	m_count = 0;
+}
+
+//----------------------------------------------------------------------------
+// Create
+//----------------------------------------------------------------------------
+bool StatsSegment::Create(const string& name, uint32_t slots)
+{
+	ASSERT_TRUE(ProcessSegment() == nullptr);
+	ASSERT_TRUE(slots > 0);
+
+	StatsSegment* segment = new StatsSegment();
+	if (!segment->Map(name, slots))
+	{
+		delete segment;
+		return false;
+	}
+	ProcessSegment() = segment;
+	return true;
+}
+
+//----------------------------------------------------------------------------
+// Destroy
+//----------------------------------------------------------------------------
+void StatsSegment::Destroy()
+{
+	delete ProcessSegment();
+	ProcessSegment() = nullptr;
+}
+
+//----------------------------------------------------------------------------
+// AcquireSlot
+//----------------------------------------------------------------------------
+StatsSegment::Slot* StatsSegment::AcquireSlot(const string& workerName)
+{
+	StatsSegment* segment = ProcessSegment();
+	if (segment == nullptr)
+		return nullptr;
+
+	for (uint32_t i = 0; i < segment->GetSlotCount(); i++)
+	{
+		// 2 marks a slot being initialized; readers only show slots in state 1
+		Slot* slot = segment->GetSlot(i);
+		uint32_t expected = 0;
+		if (!slot->inUse.compare_exchange_strong(expected, 2, memory_order_acquire))
+			continue;
+
+		uint64_t name[4] = {};
+		memcpy(name, workerName.data(), min(workerName.size(), sizeof(name) - 1));
+
+		uint32_t seq = slot->seq.load(memory_order_relaxed);
+		slot->seq.store(seq + 1, memory_order_relaxed);
+		atomic_thread_fence(memory_order_release);
+		for (int w = 0; w < 4; w++)
+			slot->name[w].store(name[w], memory_order_relaxed);
+		slot->queueDepth.store(0, memory_order_relaxed);
+		slot->dispatched.store(0, memory_order_relaxed);
+		slot->busyNs.store(0, memory_order_relaxed);
+		slot->waitP50Ns.store(0, memory_order_relaxed);
+		slot->waitP99Ns.store(0, memory_order_relaxed);
+		slot->lockAcquired.store(0, memory_order_relaxed);
+		slot->lockContended.store(0, memory_order_relaxed);
+		slot->lockWaitNs.store(0, memory_order_relaxed);
+		slot->lockHoldNs.store(0, memory_order_relaxed);
+		slot->timestampNs.store(0, memory_order_relaxed);
+		slot->currentMsgId.store(0, memory_order_relaxed);
+		slot->seq.store(seq + 2, memory_order_release);
+
+		slot->inUse.store(1, memory_order_release);
+		return slot;
+	}
+	return nullptr;
+}
+
+//----------------------------------------------------------------------------
+// ReleaseSlot
+//----------------------------------------------------------------------------
+void StatsSegment::ReleaseSlot(Slot* slot)
+{
+	slot->currentMsgId.store(0, memory_order_relaxed);
+	slot->inUse.store(0, memory_order_release);
+}
+
+//----------------------------------------------------------------------------
+// Publish
+//----------------------------------------------------------------------------
+void StatsSegment::Publish(Slot* slot, const WorkerStats& stats)
+{
+	uint32_t seq = slot->seq.load(memory_order_relaxed);
+	slot->seq.store(seq + 1, memory_order_relaxed);
+	atomic_thread_fence(memory_order_release);
+	slot->queueDepth.store(stats.queueDepth, memory_order_relaxed);
+	slot->dispatched.store(stats.dispatched, memory_order_relaxed);
+	slot->busyNs.store(stats.busyNs, memory_order_relaxed);
+	slot->waitP50Ns.store(stats.waitP50Ns, memory_order_relaxed);
+	slot->waitP99Ns.store(stats.waitP99Ns, memory_order_relaxed);
+	slot->lockAcquired.store(stats.lockAcquired, memory_order_relaxed);
+	slot->lockContended.store(stats.lockContended, memory_order_relaxed);
+	slot->lockWaitNs.store(stats.lockWaitNs, memory_order_relaxed);
+	slot->lockHoldNs.store(stats.lockHoldNs, memory_order_relaxed);
+	slot->timestampNs.store(stats.timestampNs, memory_order_relaxed);
+	slot->seq.store(seq + 2, memory_order_release);
+}
+
+//----------------------------------------------------------------------------
+// StatsSegment
+//----------------------------------------------------------------------------
+StatsSegment::StatsSegment() : m_base(nullptr), m_size(0), m_owner(false)
+#ifdef WIN32
+	, m_mapping(nullptr)
+#endif
+{
+}
+
+//----------------------------------------------------------------------------
+// ~StatsSegment
+//----------------------------------------------------------------------------
+StatsSegment::~StatsSegment()
+{
+	Unmap();
+}
+
+//----------------------------------------------------------------------------
+// Attach
+//----------------------------------------------------------------------------
+bool StatsSegment::Attach(const string& name)
+{
+	ASSERT_TRUE(m_base == nullptr);
+	return Map(name, 0);
+}
+
+//----------------------------------------------------------------------------
+// GetSlotCount
+//----------------------------------------------------------------------------
+uint32_t StatsSegment::GetSlotCount() const
+{
+	ASSERT_TRUE(m_base != nullptr);
+	return static_cast<const Header*>(m_base)->slotCount;
+}
+
+//----------------------------------------------------------------------------
+// GetSlot
+//----------------------------------------------------------------------------
+StatsSegment::Slot* StatsSegment::GetSlot(uint32_t index) const
+{
+	ASSERT_TRUE(index < GetSlotCount());
+	return reinterpret_cast<Slot*>(static_cast<char*>(m_base) + SLOTS_OFFSET) + index;
+}
+
+//----------------------------------------------------------------------------
+// Read
+//----------------------------------------------------------------------------
+bool StatsSegment::Read(uint32_t index, WorkerStats& stats) const
+{
+	const Slot* slot = GetSlot(index);
+	if (slot->inUse.load(memory_order_acquire) != 1)
+		return false;
+
+	// Retry while the owner is mid-publish, giving up if it never finishes
+	for (int attempt = 0; ; attempt++)
+	{
+		if (attempt == READ_RETRIES)
+			return false;
+
+		uint32_t seq = slot->seq.load(memory_order_acquire);
+		if (seq & 1)
+		{
+			this_thread::yield();
+			continue;
+		}
+
+		uint64_t name[4];
+		for (int w = 0; w < 4; w++)
+			name[w] = slot->name[w].load(memory_order_relaxed);
+		memcpy(stats.name, name, sizeof(stats.name));
+		stats.name[sizeof(stats.name) - 1] = '\0';
+		stats.queueDepth = slot->queueDepth.load(memory_order_relaxed);
+		stats.dispatched = slot->dispatched.load(memory_order_relaxed);
+		stats.busyNs = slot->busyNs.load(memory_order_relaxed);
+		stats.waitP50Ns = slot->waitP50Ns.load(memory_order_relaxed);
+		stats.waitP99Ns = slot->waitP99Ns.load(memory_order_relaxed);
+		stats.lockAcquired = slot->lockAcquired.load(memory_order_relaxed);
+		stats.lockContended = slot->lockContended.load(memory_order_relaxed);
+		stats.lockWaitNs = slot->lockWaitNs.load(memory_order_relaxed);
+		stats.lockHoldNs = slot->lockHoldNs.load(memory_order_relaxed);
+		stats.timestampNs = slot->timestampNs.load(memory_order_relaxed);
+
+		atomic_thread_fence(memory_order_acquire);
+		if (slot->seq.load(memory_order_relaxed) == seq)
+			break;
+		this_thread::yield();
+	}
+	stats.currentMsgId = slot->currentMsgId.load(memory_order_relaxed);
+	return true;
+}
+
+//----------------------------------------------------------------------------
+// Map
+//----------------------------------------------------------------------------
+bool StatsSegment::Map(const string& name, uint32_t slots)
+{
+	bool create = slots > 0;
+	size_t size = SLOTS_OFFSET + sizeof(Slot) * slots;
+
+#ifdef WIN32
+	string mappingName = "Local\\" + name;
+	if (create)
+	{
+		m_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+			static_cast<DWORD>(static_cast<uint64_t>(size) >> 32), static_cast<DWORD>(size), mappingName.c_str());
+		if (m_mapping == nullptr)
+			return false;
+		m_base = MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	}
+	else
+	{
+		m_mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, mappingName.c_str());
+		if (m_mapping == nullptr)
+			return false;
+		m_base = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+		MEMORY_BASIC_INFORMATION info;
+		if (m_base && VirtualQuery(m_base, &info, sizeof(info)))
+			size = info.RegionSize;
+	}
+	if (m_base == nullptr)
+	{
+		Unmap();
+		return false;
+	}
+#else
+	string shmName = "/" + name;
+	int fd = create ? shm_open(shmName.c_str(), O_CREAT | O_RDWR, 0644) : shm_open(shmName.c_str(), O_RDONLY, 0);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	bool sized = create ? ftruncate(fd, static_cast<off_t>(size)) == 0 : fstat(fd, &st) == 0;
+	if (!create && sized)
+		size = static_cast<size_t>(st.st_size);
+	void* base = sized && size >= SLOTS_OFFSET ?
+		mmap(nullptr, size, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+	close(fd);
+	if (base == MAP_FAILED)
+	{
+		if (create)
+			shm_unlink(shmName.c_str());
+		return false;
+	}
+	m_base = base;
+#endif
+
+	m_name = name;
+	m_size = size;
+	m_owner = create;
+
+	Header* header = static_cast<Header*>(m_base);
+	if (create)
+	{
+		// A segment left by a crashed process is reset
+		memset(m_base, 0, size);
+		header->version = VERSION;
+		header->slotCount = slots;
+		atomic_thread_fence(memory_order_release);
+		header->magic = MAGIC;
+	}
+	else if (header->magic != MAGIC || header->version != VERSION ||
+		SLOTS_OFFSET + sizeof(Slot) * header->slotCount > size)
+	{
+		Unmap();
+		return false;
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------------
+// Unmap
+//----------------------------------------------------------------------------
+void StatsSegment::Unmap()
+{
+#ifdef WIN32
+	if (m_base)
+		UnmapViewOfFile(m_base);
+	if (m_mapping)
+		CloseHandle(m_mapping);
+	m_mapping = nullptr;
+#else
+	if (m_base)
+		munmap(m_base, m_size);
+	if (m_owner)
+		shm_unlink(("/" + m_name).c_str());
+#endif
+	m_base = nullptr;
+	m_owner = false;
+}
@@ -0,0 +1,163 @@
+#ifndef _STATS_SEGMENT_H
+#define _STATS_SEGMENT_H
+
+// Live WorkerThread statistics in a named shared-memory segment.
+//
+// The monitored process creates the segment once with Create(). Each
+// WorkerThread created afterwards claims a slot and publishes its counters
+// there on every timer tick under a per-slot sequence lock, and its current
+// message id on every dispatch. Writers never block or allocate. An external
+// tool maps the segment read-only with Attach() and reads consistent
+// snapshots by retrying while a slot is being written, so inspection has no
+// effect on the monitored workers.
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/// One worker's published counters
+struct WorkerStats
+{
+    char name[32];
+    uint64_t queueDepth;    ///< Messages queued at the last publish
+    uint64_t dispatched;    ///< Messages and work items dispatched since start
+    uint64_t busyNs;        ///< Time spent dispatching since start
+    uint64_t waitP50Ns;     ///< Median queue wait over the last publish interval
+    uint64_t waitP99Ns;     ///< 99th percentile queue wait over the last publish interval
+    uint64_t lockAcquired;  ///< Queue lock acquisitions since start
+    uint64_t lockContended; ///< Queue lock acquisitions that had to wait
+    uint64_t lockWaitNs;    ///< Time spent waiting for the queue lock
+    uint64_t lockHoldNs;    ///< Time the queue lock was held
+    uint64_t timestampNs;   ///< Steady clock time of the last publish
+    int32_t currentMsgId;   ///< Id of the message being dispatched, -1 for a work item, 0 if idle
+};
+
+/// Queue wait distribution over one publish interval. Buckets split each
+/// power of two into four, so reported percentiles are within 25%.
+class WaitWindow
+{
+public:
+    WaitWindow() { Reset(); }
+
+    /// Record a queue wait
+    /// @param[in] ticks - the wait in TscClock ticks
+    void Record(uint64_t ticks);
+
+    /// @param[in] percentile - 0 to 100
+    /// @return The upper bound of the bucket holding the percentile, or 0 if empty
+    uint64_t Percentile(double percentile) const;
+
+    /// Remove all values
+    void Reset();
+
+private:
+    static const size_t BUCKETS = 64 * 4;
+    uint64_t m_counts[BUCKETS];
+    uint64_t m_count;
+};
+
+class StatsSegment
+{
+public:
+    /// Shared-memory layout of one worker slot
+    struct alignas(64) Slot
+    {
+        std::atomic<uint32_t> seq;      ///< Odd while a write is in progress
+        std::atomic<uint32_t> inUse;
+        std::atomic<int32_t> currentMsgId;
+        std::atomic<uint64_t> name[4];
+        std::atomic<uint64_t> queueDepth;
+        std::atomic<uint64_t> dispatched;
+        std::atomic<uint64_t> busyNs;
+        std::atomic<uint64_t> waitP50Ns;
+        std::atomic<uint64_t> waitP99Ns;
+        std::atomic<uint64_t> lockAcquired;
+        std::atomic<uint64_t> lockContended;
+        std::atomic<uint64_t> lockWaitNs;
+        std::atomic<uint64_t> lockHoldNs;
+        std::atomic<uint64_t> timestampNs;
+    };
+
+    /// Create the process wide segment that WorkerThreads publish into.
+    /// Call before creating the workers to monitor.
+    /// @param[in] name - the segment name, e.g. "WorkerThreadStats"
+    /// @param[in] slots - the maximum number of workers
+    /// @return True if the segment was created
+    static bool Create(const std::string& name, uint32_t slots);
+
+    /// Remove the process wide segment. Workers must have exited.
+    static void Destroy();
+
+    /// Claim a slot in the process wide segment
+    /// @param[in] workerName - the name shown by viewers
+    /// @return The slot, or nullptr if there is no segment or no free slot
+    static Slot* AcquireSlot(const std::string& workerName);
+
+    /// Return a slot claimed with AcquireSlot()
+    /// @param[in] slot - the slot
+    static void ReleaseSlot(Slot* slot);
+
+    /// Publish counters to a slot. Only called by the slot's owner.
+    /// @param[in] slot - the slot
+    /// @param[in] stats - the counters; name and currentMsgId are ignored
+    static void Publish(Slot* slot, const WorkerStats& stats);
+
+    /// Set the message id being dispatched
+    /// @param[in] slot - the slot
+    /// @param[in] id - the message id, 0 when idle
+    static void SetCurrentMsgId(Slot* slot, int32_t id) { slot->currentMsgId.store(id, std::memory_order_relaxed); }
+
+    StatsSegment();
+    ~StatsSegment();
+
+    /// Map an existing segment read-only
+    /// @param[in] name - the segment name passed to Create()
+    /// @return True if the segment was mapped
+    bool Attach(const std::string& name);
+
+    /// @return The number of slots in an attached segment
+    uint32_t GetSlotCount() const;
+
+    /// Read a consistent snapshot of one slot
+    /// @param[in] index - the slot index
+    /// @param[out] stats - receives the counters
+    /// @return False if the slot is not in use, or if its writer never finished
+    /// a publish (e.g. the process died mid-write) within a bounded number of retries
+    bool Read(uint32_t index, WorkerStats& stats) const;
+
+private:
+    StatsSegment(const StatsSegment&) = delete;
+    StatsSegment& operator=(const StatsSegment&) = delete;
+
+    struct Header
+    {
+        uint64_t magic;
+        uint32_t version;
+        uint32_t slotCount;
+    };
+
+    /// Map a segment
+    /// @param[in] name - the segment name
+    /// @param[in] slots - the slot count when creating, 0 to attach read-only
+    /// @return True on success
+    bool Map(const std::string& name, uint32_t slots);
+
+    /// Unmap the segment, removing its name if this instance created it
+    void Unmap();
+
+    Slot* GetSlot(uint32_t index) const;
+
+    static const uint64_t MAGIC = 0x5354415453575448ull;
+    static const uint32_t VERSION = 1;
+
+    std::string m_name;
+    void* m_base;
+    size_t m_size;
+    bool m_owner;
+#ifdef WIN32
+    void* m_mapping;
+#endif
+};
+
+#endif
@@ -0,0 +1,129 @@
+#include "TaskGroup.h"
+#include "Fault.h"
+
+using namespace std;
+
+//----------------------------------------------------------------------------
+// TaskGroup
+//----------------------------------------------------------------------------
+TaskGroup::TaskGroup() : m_state(make_shared<State>()), m_joined(false)
+{
+}
+
+//----------------------------------------------------------------------------
+// TaskGroup
+//----------------------------------------------------------------------------
+TaskGroup::TaskGroup(TaskGroup& parent) : m_state(make_shared<State>()), m_joined(false)
+{
+	// The nested group is one outstanding child of the parent
+	parent.m_state->outstanding.fetch_add(1, memory_order_relaxed);
+	m_state->parent = parent.m_state;
+
+	// Parent cancellation propagates down. The callback runs immediately if
+	// the parent is already cancelled.
+	stop_source source = m_state->source;
+	m_state->parentLink.emplace(parent.m_state->source.get_token(), function<void()>([source]() mutable {
+		source.request_stop();
+	}));
+}
+
+//----------------------------------------------------------------------------
+// ~TaskGroup
+//----------------------------------------------------------------------------
+TaskGroup::~TaskGroup()
+{
+	if (!m_joined.load(memory_order_relaxed))
+		Join();
+}
+
+//----------------------------------------------------------------------------
+// Spawn
+//----------------------------------------------------------------------------
+void TaskGroup::Spawn(WorkerThread& worker, function<bool(stop_token)> task)
+{
+	ASSERT_TRUE(task);
+
+	// After Join() only running children may spawn, and they keep the count
+	// above zero. A top level spawn into a completed group would complete it twice.
+	shared_ptr<State> state = m_state;
+	size_t outstanding = state->outstanding.fetch_add(1, memory_order_relaxed);
+	ASSERT_TRUE(!m_joined.load(memory_order_relaxed) || outstanding > 0);
+	shared_ptr<ChildGuard> guard = make_shared<ChildGuard>(state);
+
+	stop_token token = state->source.get_token();
+	worker.PostTask([guard, task, token]() {
+		if (!task(token))
+			guard->state->Fail();
+	}, token);
+}
+
+//----------------------------------------------------------------------------
+// Cancel
+//----------------------------------------------------------------------------
+void TaskGroup::Cancel()
+{
+	m_state->source.request_stop();
+}
+
+//----------------------------------------------------------------------------
+// IsCancelled
+//----------------------------------------------------------------------------
+bool TaskGroup::IsCancelled() const
+{
+	return m_state->source.stop_requested();
+}
+
+//----------------------------------------------------------------------------
+// GetToken
+//----------------------------------------------------------------------------
+stop_token TaskGroup::GetToken() const
+{
+	return m_state->source.get_token();
+}
+
+//----------------------------------------------------------------------------
+// Join
+//----------------------------------------------------------------------------
+Future<bool> TaskGroup::Join()
+{
+	bool joined = m_joined.exchange(true, memory_order_relaxed);
+	ASSERT_TRUE(!joined);
+
+	Future<bool> result = m_state->done.GetFuture();
+	m_state->Release();
+	return result;
+}
+
+//----------------------------------------------------------------------------
+// State::Fail
+//----------------------------------------------------------------------------
+void TaskGroup::State::Fail()
+{
+	failed.store(true, memory_order_relaxed);
+	source.request_stop();
+}
+
+//----------------------------------------------------------------------------
+// State::Release
+//----------------------------------------------------------------------------
+void TaskGroup::State::Release()
+{
+	if (outstanding.fetch_sub(1, memory_order_acq_rel) != 1)
+		return;
+
+	// A group that was cancelled did not run all of its children
+	bool succeeded = !failed.load(memory_order_relaxed) && !source.stop_requested();
+
+	// Detach from the parent before completing so the callback cannot fire
+	// later. Failure propagates up; a local Cancel() does not.
+	parentLink.reset();
+	if (parent)
+	{
+		if (failed.load(memory_order_relaxed))
+			parent->Fail();
+		shared_ptr<State> p = std::move(parent);
+		p->Release();
+	}
+
+	done.SetValue(succeeded);
+}
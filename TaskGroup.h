@@ -0,0 +1,90 @@
+#ifndef _TASK_GROUP_H
+#define _TASK_GROUP_H
+
+// Structured task groups spanning WorkerThreads.
+//
+// A TaskGroup tracks child tasks posted to any number of workers. All children
+// share the group's stop token: Process() discards a queued child once a stop
+// is requested, and running children can poll the token to bail out early. A
+// child that reports failure cancels its siblings. Join() returns a future
+// that becomes ready once every child has finished or been discarded.
+//
+// Groups nest. A group constructed with a parent counts as one child of the
+// parent, inherits the parent's cancellation and reports failure upward.
+
+#include "WorkerThread.h"
+#include "Future.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stop_token>
+
+class TaskGroup
+{
+public:
+    /// Constructor for a root group
+    TaskGroup();
+
+    /// Constructor for a nested group
+    /// @param[in] parent - the enclosing group
+    explicit TaskGroup(TaskGroup& parent);
+
+    /// Destructor. Joins the group if Join() was not called; does not wait.
+    ~TaskGroup();
+
+    /// Post a child task to a worker thread. After Join() only a running child
+    /// may call it; a top level Spawn() after Join() is an error.
+    /// @param[in] worker - the worker thread to run the child on
+    /// @param[in] task - receives the group's stop token; returns false on failure
+    void Spawn(WorkerThread& worker, std::function<bool(std::stop_token)> task);
+
+    /// Request cancellation of all children not yet dispatched
+    void Cancel();
+
+    /// @return True if the group was cancelled or a child failed
+    bool IsCancelled() const;
+
+    /// @return The stop token shared by all children
+    std::stop_token GetToken() const;
+
+    /// Close the group to new top level work. Children may still spawn children.
+    /// @return A future that is ready when all children have finished; true
+    /// if every child ran and succeeded
+    Future<bool> Join();
+
+private:
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    struct State
+    {
+        std::stop_source source;
+        std::atomic<size_t> outstanding{1};
+        std::atomic<bool> failed{false};
+        Promise<bool> done;
+        std::shared_ptr<State> parent;
+        std::optional<std::stop_callback<std::function<void()>>> parentLink;
+
+        /// Cancel the group and record failure
+        void Fail();
+
+        /// Release one outstanding reference; the last completes the group
+        void Release();
+    };
+
+    /// Releases a child's outstanding reference when the child task is
+    /// destroyed, whether it ran or was discarded
+    struct ChildGuard
+    {
+        explicit ChildGuard(std::shared_ptr<State> s) : state(std::move(s)) {}
+        ~ChildGuard() { state->Release(); }
+        std::shared_ptr<State> state;
+    };
+
+    std::shared_ptr<State> m_state;
+    /// Read by children spawning from other threads
+    std::atomic<bool> m_joined;
+};
+
+#endif
@@ -0,0 +1,53 @@
+#include "TokenBucket.h"
+#include "Fault.h"
+#include <algorithm>
+
+using namespace std;
+
+//----------------------------------------------------------------------------
+// TokenBucket
+//----------------------------------------------------------------------------
+TokenBucket::TokenBucket(double rate, uint32_t burst) :
+	m_emission(static_cast<int64_t>(1e9 / rate)),
+	m_tolerance(m_emission * burst),
+	m_tat(0)
+{
+	ASSERT_TRUE(rate > 0);
+	ASSERT_TRUE(burst > 0);
+}
+
+//----------------------------------------------------------------------------
+// Now
+//----------------------------------------------------------------------------
+int64_t TokenBucket::Now()
+{
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//----------------------------------------------------------------------------
+// TryAcquire
+//----------------------------------------------------------------------------
+bool TokenBucket::TryAcquire(uint32_t tokens)
+{
+	int64_t now = Now();
+	int64_t tat = m_tat.load(memory_order_relaxed);
+	while (true)
+	{
+		// An idle bucket refills; credit never accumulates beyond the burst
+		int64_t newTat = max(tat, now) + m_emission * tokens;
+		if (newTat - now > m_tolerance)
+			return false;
+		if (m_tat.compare_exchange_weak(tat, newTat, memory_order_relaxed, memory_order_relaxed))
+			return true;
+	}
+}
+
+//----------------------------------------------------------------------------
+// TimeUntilAvailable
+//----------------------------------------------------------------------------
+chrono::nanoseconds TokenBucket::TimeUntilAvailable(uint32_t tokens) const
+{
+	int64_t now = Now();
+	int64_t newTat = max(m_tat.load(memory_order_relaxed), now) + m_emission * tokens;
+	return chrono::nanoseconds(max<int64_t>(newTat - now - m_tolerance, 0));
+}
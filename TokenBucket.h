@@ -0,0 +1,51 @@
+#ifndef _TOKEN_BUCKET_H
+#define _TOKEN_BUCKET_H
+
+// Lock-free token bucket.
+//
+// Implemented as the generic cell rate algorithm: the bucket state is a single
+// theoretical arrival time (TAT) that advances by one emission interval per
+// token taken. A request is admitted if the advanced TAT stays within the
+// burst tolerance of now. Acquiring is one clock read and a CAS loop on one
+// atomic; no mutex, no refill thread.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+class TokenBucket
+{
+public:
+    /// Constructor. The bucket starts full.
+    /// @param[in] rate - tokens added per second
+    /// @param[in] burst - bucket capacity in tokens
+    TokenBucket(double rate, uint32_t burst);
+
+    /// Take tokens if available. Thread-safe.
+    /// @param[in] tokens - the number of tokens
+    /// @return True if the tokens were taken
+    bool TryAcquire(uint32_t tokens = 1);
+
+    /// Get the time until tokens are available. Thread-safe.
+    /// @param[in] tokens - the number of tokens
+    /// @return Zero if available now
+    std::chrono::nanoseconds TimeUntilAvailable(uint32_t tokens = 1) const;
+
+private:
+    TokenBucket(const TokenBucket&) = delete;
+    TokenBucket& operator=(const TokenBucket&) = delete;
+
+    /// @return The current time in nanoseconds on the steady clock
+    static int64_t Now();
+
+    /// Nanoseconds per token
+    const int64_t m_emission;
+
+    /// Burst tolerance in nanoseconds
+    const int64_t m_tolerance;
+
+    /// Theoretical arrival time in steady clock nanoseconds
+    std::atomic<int64_t> m_tat;
+};
+
+#endif
@@ -0,0 +1,221 @@
+#include "Tracer.h"
+#include "TscClock.h"
+#include "Fault.h"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+using namespace std;
+
+atomic<bool> Tracer::s_enabled{false};
+
+namespace
+{
+	struct Span
+	{
+		TraceContext context;
+		char worker[32];
+		int msgId;
+		uint64_t enqueue;
+		uint64_t start;
+		uint64_t end;
+	};
+
+	// One per recording thread so dispatches on different workers do not
+	// contend. The lock is only contended while dumping.
+	struct SpanBuffer
+	{
+		mutex lock;
+		vector<Span> spans;
+	};
+
+	struct Registry
+	{
+		mutex lock;
+		vector<SpanBuffer*> buffers;
+		vector<Span> retired;       // Spans of threads that have exited
+		uint64_t epoch = 0;
+	};
+
+	// Never destroyed so workers may record during static destruction
+	Registry& GetRegistry()
+	{
+		static Registry* registry = new Registry();
+		return *registry;
+	}
+
+	atomic<uint32_t> s_sampleEvery{1};
+	atomic<size_t> s_maxSpans{0};
+	atomic<uint64_t> s_nextId{1};
+	atomic<uint64_t> s_rootPosts{0};
+	atomic<size_t> s_spanCount{0};
+	atomic<uint64_t> s_dropped{0};
+
+	// Owns the calling thread's buffer. On thread exit its spans move to the
+	// registry so Dump() still sees them, and the buffer is freed.
+	struct BufferOwner
+	{
+		SpanBuffer* buffer = nullptr;
+
+		~BufferOwner()
+		{
+			if (buffer == nullptr)
+				return;
+			Registry& registry = GetRegistry();
+			lock_guard<mutex> lock(registry.lock);
+			registry.buffers.erase(find(registry.buffers.begin(), registry.buffers.end(), buffer));
+			registry.retired.insert(registry.retired.end(), buffer->spans.begin(), buffer->spans.end());
+			delete buffer;
+		}
+	};
+
+	thread_local TraceContext t_current;
+	thread_local BufferOwner t_owner;
+
+	SpanBuffer& GetBuffer()
+	{
+		if (t_owner.buffer == nullptr)
+		{
+			t_owner.buffer = new SpanBuffer();
+			Registry& registry = GetRegistry();
+			lock_guard<mutex> lock(registry.lock);
+			registry.buffers.push_back(t_owner.buffer);
+		}
+		return *t_owner.buffer;
+	}
+
+	// Nanoseconds since Start(). Enqueue on another core may read a slightly
+	// earlier counter than the epoch, so convert signed.
+	int64_t Relative(uint64_t ticks, uint64_t epoch)
+	{
+		if (ticks >= epoch)
+			return static_cast<int64_t>(TscClock::ToNanoseconds(ticks - epoch));
+		return -static_cast<int64_t>(TscClock::ToNanoseconds(epoch - ticks));
+	}
+
+	void WriteSpan(ostream& os, const Span& span, uint64_t epoch)
+	{
+		os << span.context.traceId << '\t' << span.context.spanId << '\t' << span.context.parentId << '\t'
+			<< span.worker << '\t' << span.msgId << '\t'
+			<< Relative(span.enqueue, epoch) << '\t'
+			<< Relative(span.start, epoch) << '\t'
+			<< Relative(span.end, epoch) << '\n';
+	}
+}
+
+//----------------------------------------------------------------------------
+// Start
+//----------------------------------------------------------------------------
+void Tracer::Start(uint32_t sampleEvery, size_t maxSpans)
+{
+	ASSERT_TRUE(sampleEvery > 0);
+
+	Registry& registry = GetRegistry();
+	lock_guard<mutex> lock(registry.lock);
+	for (SpanBuffer* buffer : registry.buffers)
+	{
+		lock_guard<mutex> bufferLock(buffer->lock);
+		buffer->spans.clear();
+	}
+	registry.retired.clear();
+	s_sampleEvery.store(sampleEvery, memory_order_relaxed);
+	s_maxSpans.store(maxSpans, memory_order_relaxed);
+	registry.epoch = TscClock::Now();
+	s_rootPosts.store(0, memory_order_relaxed);
+	s_spanCount.store(0, memory_order_relaxed);
+	s_dropped.store(0, memory_order_relaxed);
+	s_enabled.store(true, memory_order_release);
+}
+
+//----------------------------------------------------------------------------
+// Stop
+//----------------------------------------------------------------------------
+void Tracer::Stop()
+{
+	s_enabled.store(false, memory_order_release);
+}
+
+//----------------------------------------------------------------------------
+// Dump
+//----------------------------------------------------------------------------
+void Tracer::Dump(ostream& os)
+{
+	Registry& registry = GetRegistry();
+	lock_guard<mutex> lock(registry.lock);
+	os << "# trace\tspan\tparent\tworker\tmsg\tenqueue_ns\tstart_ns\tend_ns\n";
+	for (SpanBuffer* buffer : registry.buffers)
+	{
+		lock_guard<mutex> bufferLock(buffer->lock);
+		for (const Span& span : buffer->spans)
+			WriteSpan(os, span, registry.epoch);
+	}
+	for (const Span& span : registry.retired)
+		WriteSpan(os, span, registry.epoch);
+}
+
+//----------------------------------------------------------------------------
+// GetDroppedCount
+//----------------------------------------------------------------------------
+uint64_t Tracer::GetDroppedCount()
+{
+	return s_dropped.load(memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// NewContext
+//----------------------------------------------------------------------------
+TraceContext Tracer::NewContext()
+{
+	TraceContext context;
+	if (t_current.traceId != 0)
+	{
+		context.traceId = t_current.traceId;
+		context.parentId = t_current.spanId;
+	}
+	else
+	{
+		uint32_t sampleEvery = s_sampleEvery.load(memory_order_relaxed);
+		if (s_rootPosts.fetch_add(1, memory_order_relaxed) % sampleEvery != 0)
+			return context;
+		context.traceId = s_nextId.fetch_add(1, memory_order_relaxed);
+	}
+	context.spanId = s_nextId.fetch_add(1, memory_order_relaxed);
+	return context;
+}
+
+//----------------------------------------------------------------------------
+// SetCurrent
+//----------------------------------------------------------------------------
+void Tracer::SetCurrent(const TraceContext& context)
+{
+	t_current = context;
+}
+
+//----------------------------------------------------------------------------
+// Record
+//----------------------------------------------------------------------------
+void Tracer::Record(const TraceContext& context, const string& worker, int msgId,
+	uint64_t enqueue, uint64_t start, uint64_t end)
+{
+	if (!IsEnabled())
+		return;
+	if (s_spanCount.fetch_add(1, memory_order_relaxed) >= s_maxSpans.load(memory_order_relaxed))
+	{
+		s_dropped.fetch_add(1, memory_order_relaxed);
+		return;
+	}
+
+	Span span;
+	span.context = context;
+	memset(span.worker, 0, sizeof(span.worker));
+	memcpy(span.worker, worker.data(), min(worker.size(), sizeof(span.worker) - 1));
+	span.msgId = msgId;
+	span.enqueue = enqueue;
+	span.start = start;
+	span.end = end;
+
+	SpanBuffer& buffer = GetBuffer();
+	lock_guard<mutex> lock(buffer.lock);
+	buffer.spans.push_back(span);
+}
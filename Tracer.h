@@ -0,0 +1,75 @@
+#ifndef _TRACER_H
+#define _TRACER_H
+
+// Causal tracing of messages across WorkerThreads.
+//
+// While tracing is started, a message posted from outside any traced handler
+// may begin a new trace, and a message posted from inside a traced handler
+// joins the handler's trace as its child. Each dispatch of a traced message
+// records one span: the worker, message id and the enqueue, start and end
+// times, so every hop's queue wait (start - enqueue) and service time
+// (end - start) are known. Timestamps are TscClock ticks until Dump()
+// converts them to nanoseconds since Start(). tools/TraceAnalyzer rebuilds
+// the trace trees from a dump and reports their critical paths.
+//
+// Work items and coroutine resumptions are not ThreadMsgs and are not traced.
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/// Trace identity carried by a queued message. A zero traceId means untraced.
+struct TraceContext
+{
+    uint64_t traceId = 0;
+    uint64_t spanId = 0;
+    uint64_t parentId = 0;      ///< Span of the handler that posted the message, 0 for a root
+};
+
+class Tracer
+{
+public:
+    /// Start tracing. Spans recorded by an earlier run are discarded.
+    /// @param[in] sampleEvery - begin a trace for one in this many root posts
+    /// @param[in] maxSpans - spans kept before further spans are dropped
+    static void Start(uint32_t sampleEvery = 1, size_t maxSpans = 1000000);
+
+    /// Stop beginning and recording spans. Recorded spans are kept for Dump().
+    static void Stop();
+
+    /// Write recorded spans, one per line, tab separated:
+    /// trace span parent worker msg enqueue_ns start_ns end_ns
+    /// @param[in] os - the output stream
+    static void Dump(std::ostream& os);
+
+    /// @return The number of spans dropped because maxSpans was reached
+    static uint64_t GetDroppedCount();
+
+    /// @return True while tracing is started
+    static bool IsEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    /// Context for a message being posted by the calling thread: a child of
+    /// the handler being dispatched, a new sampled root, or untraced.
+    /// Called by WorkerThread when tracing is enabled.
+    static TraceContext NewContext();
+
+    /// Set the context of the handler the calling thread is dispatching
+    /// @param[in] context - the message's context, or an empty context when done
+    static void SetCurrent(const TraceContext& context);
+
+    /// Record one dispatch of a traced message
+    /// @param[in] context - the message's context
+    /// @param[in] worker - the dispatching worker's name
+    /// @param[in] msgId - the message id
+    /// @param[in] enqueue - TscClock ticks when the message was queued
+    /// @param[in] start - TscClock ticks when dispatch started
+    /// @param[in] end - TscClock ticks when dispatch ended
+    static void Record(const TraceContext& context, const std::string& worker, int msgId,
+        uint64_t enqueue, uint64_t start, uint64_t end);
+
+private:
+    static std::atomic<bool> s_enabled;
+};
+
+#endif
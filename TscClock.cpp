@@ -0,0 +1,162 @@
+#include "TscClock.h"
+#include <mutex>
+#include <thread>
+
+#ifdef TSC_CLOCK_RDTSC
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+using namespace std;
+
+atomic<int> TscClock::s_source{TscClock::SOURCE_UNSELECTED};
+
+namespace
+{
+	// Minimum interval the tick rate is measured over
+	const chrono::milliseconds CALIBRATION_INTERVAL(20);
+
+	// Written once before s_source is published
+	uint64_t s_referenceTsc = 0;
+	uint64_t s_referenceNs = 0;
+
+	// Written once by Calibrate(); steady_clock ticks are nanoseconds
+	double s_nsPerTick = 1.0;
+	double s_ticksPerNs = 1.0;
+
+	uint64_t SteadyNanoseconds()
+	{
+		return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(
+			chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+#ifdef TSC_CLOCK_RDTSC
+	// CPUID 0x80000007 EDX bit 8 advertises an invariant TSC
+	bool HasInvariantTsc()
+	{
+#ifdef _MSC_VER
+		int regs[4];
+		__cpuid(regs, 0x80000000);
+		if (static_cast<unsigned>(regs[0]) < 0x80000007)
+			return false;
+		__cpuid(regs, 0x80000007);
+		return (regs[3] & (1 << 8)) != 0;
+#else
+		unsigned eax, ebx, ecx, edx;
+		if (__get_cpuid_max(0x80000000, nullptr) < 0x80000007)
+			return false;
+		if (!__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx))
+			return false;
+		return (edx & (1 << 8)) != 0;
+#endif
+	}
+
+	// Read steady_clock between two TSC reads and pair it with their midpoint
+	void ReadPair(uint64_t& tsc, uint64_t& ns)
+	{
+		uint64_t before = __rdtsc();
+		ns = SteadyNanoseconds();
+		uint64_t after = __rdtsc();
+		tsc = before + (after - before) / 2;
+	}
+#endif
+}
+
+//----------------------------------------------------------------------------
+// SelectSource
+//----------------------------------------------------------------------------
+void TscClock::SelectSource()
+{
+	static once_flag once;
+	call_once(once, []() {
+		int source = SOURCE_STEADY;
+#ifdef TSC_CLOCK_RDTSC
+		if (HasInvariantTsc())
+		{
+			ReadPair(s_referenceTsc, s_referenceNs);
+			source = SOURCE_TSC;
+		}
+#endif
+		s_source.store(source, memory_order_release);
+	});
+}
+
+// Take the reference pair at load so the interval has usually elapsed by the
+// first conversion
+static const bool s_sourceSelected = (TscClock::IsTsc(), true);
+
+//----------------------------------------------------------------------------
+// Calibrate
+//----------------------------------------------------------------------------
+void TscClock::Calibrate()
+{
+	static once_flag once;
+	call_once(once, []() {
+		SelectSource();
+#ifdef TSC_CLOCK_RDTSC
+		if (s_source.load(memory_order_acquire) != SOURCE_TSC)
+			return;
+
+		uint64_t elapsed = SteadyNanoseconds() - s_referenceNs;
+		uint64_t interval = static_cast<uint64_t>(chrono::nanoseconds(CALIBRATION_INTERVAL).count());
+		if (elapsed < interval)
+			this_thread::sleep_for(chrono::nanoseconds(interval - elapsed));
+
+		uint64_t tsc, ns;
+		ReadPair(tsc, ns);
+		if (tsc > s_referenceTsc && ns > s_referenceNs)
+		{
+			s_ticksPerNs = static_cast<double>(tsc - s_referenceTsc) / static_cast<double>(ns - s_referenceNs);
+			s_nsPerTick = 1.0 / s_ticksPerNs;
+		}
+#endif
+	});
+}
+
+//----------------------------------------------------------------------------
+// SlowNow
+//----------------------------------------------------------------------------
+uint64_t TscClock::SlowNow()
+{
+	int source = s_source.load(memory_order_acquire);
+	if (source == SOURCE_UNSELECTED)
+	{
+		SelectSource();
+		source = s_source.load(memory_order_acquire);
+	}
+#ifdef TSC_CLOCK_RDTSC
+	if (source == SOURCE_TSC)
+		return __rdtsc();
+#endif
+	return SteadyNanoseconds();
+}
+
+//----------------------------------------------------------------------------
+// ToNanoseconds
+//----------------------------------------------------------------------------
+uint64_t TscClock::ToNanoseconds(uint64_t ticks)
+{
+	Calibrate();
+	return static_cast<uint64_t>(static_cast<double>(ticks) * s_nsPerTick);
+}
+
+//----------------------------------------------------------------------------
+// FromNanoseconds
+//----------------------------------------------------------------------------
+uint64_t TscClock::FromNanoseconds(uint64_t ns)
+{
+	Calibrate();
+	return static_cast<uint64_t>(static_cast<double>(ns) * s_ticksPerNs);
+}
+
+//----------------------------------------------------------------------------
+// IsTsc
+//----------------------------------------------------------------------------
+bool TscClock::IsTsc()
+{
+	SelectSource();
+	return s_source.load(memory_order_acquire) == SOURCE_TSC;
+}
@@ -0,0 +1,73 @@
+#ifndef _TSC_CLOCK_H
+#define _TSC_CLOCK_H
+
+// Low-cost timestamp source for instrumentation.
+//
+// Now() reads the CPU time stamp counter when the processor advertises an
+// invariant TSC, which ticks at a constant rate across cores and power
+// states. Otherwise it falls back to steady_clock nanoseconds. Callers store
+// and subtract raw ticks on hot paths and convert to nanoseconds only when
+// reporting.
+//
+// Choosing the source is a CPUID check done when the library loads, so Now()
+// never blocks. The tick rate is measured against steady_clock over the
+// interval since then; the first conversion sleeps only if less than the
+// calibration interval has passed. WorkerThread converts its time slice at
+// startup, so calibration happens on the worker, not on a posting thread.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TSC_CLOCK_RDTSC
+#elif defined(_M_X64) || defined(_M_IX86)
+#include <intrin.h>
+#define TSC_CLOCK_RDTSC
+#endif
+
+class TscClock
+{
+public:
+    /// @return The current time in ticks. Only differences are meaningful.
+    static uint64_t Now()
+    {
+#ifdef TSC_CLOCK_RDTSC
+        if (s_source.load(std::memory_order_relaxed) == SOURCE_TSC)
+            return __rdtsc();
+#endif
+        return SlowNow();
+    }
+
+    /// Measure the tick rate. Called by the first conversion; call at startup
+    /// to keep the calibration delay off the first conversion.
+    static void Calibrate();
+
+    /// @param[in] ticks - a tick difference
+    /// @return The difference in nanoseconds
+    static uint64_t ToNanoseconds(uint64_t ticks);
+
+    /// @param[in] ns - a duration in nanoseconds
+    /// @return The duration in ticks
+    static uint64_t FromNanoseconds(uint64_t ns);
+
+    /// @return True if ticks come from the TSC rather than steady_clock
+    static bool IsTsc();
+
+private:
+    static const int SOURCE_UNSELECTED = 0;
+    static const int SOURCE_TSC = 1;
+    static const int SOURCE_STEADY = 2;
+
+    /// Select the source without blocking. Called at static initialization
+    /// and by the first Now() if that runs earlier.
+    static void SelectSource();
+
+    /// Select the source if needed, then read it
+    static uint64_t SlowNow();
+
+    static std::atomic<int> s_source;
+};
+
+#endif
@@ -0,0 +1,26 @@
+#include "WorkerLocal.h"
+#include <atomic>
+
+using namespace std;
+
+//----------------------------------------------------------------------------
+// AllocateSlot
+//----------------------------------------------------------------------------
+size_t WorkerLocalBase::AllocateSlot()
+{
+	static atomic<size_t> nextSlot{0};
+	return nextSlot.fetch_add(1, memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// Bind
+//----------------------------------------------------------------------------
+void WorkerLocalBase::Bind(WorkerThread& worker, void* obj, void (*destroy)(void*)) const
+{
+	vector<WorkerThread::LocalSlot>& slots = worker.m_localSlots;
+	if (m_slot >= slots.size())
+		slots.resize(m_slot + 1, WorkerThread::LocalSlot{ nullptr, nullptr });
+
+	ASSERT_TRUE(slots[m_slot].obj == nullptr);
+	slots[m_slot] = { obj, destroy };
+}
@@ -0,0 +1,91 @@
+#ifndef _WORKER_LOCAL_H
+#define _WORKER_LOCAL_H
+
+// Typed per-worker storage slots.
+//
+// Each WorkerLocal<T> is assigned a slot index when it is created. Every
+// WorkerThread holds a small array of slots, so a handler reaches its own
+// instance of T with one indexed load instead of a thread_local lookup or a
+// map keyed by thread id. The instance is constructed on first access from
+// the worker and destroyed on the worker thread during ExitThread().
+//
+// WorkerLocal objects are intended to be long-lived (e.g. globals). Slot
+// indexes are not reused.
+
+#include "WorkerThread.h"
+#include "Fault.h"
+#include <functional>
+
+class WorkerLocalBase
+{
+protected:
+    WorkerLocalBase() : m_slot(AllocateSlot()) {}
+
+    /// Get the raw object stored in this slot of a worker
+    /// @param[in] worker - the worker owning the slot
+    /// @return The object, or nullptr if not yet constructed
+    void* Find(WorkerThread& worker) const
+    {
+        std::vector<WorkerThread::LocalSlot>& slots = worker.m_localSlots;
+        return m_slot < slots.size() ? slots[m_slot].obj : nullptr;
+    }
+
+    /// Store a newly constructed object in this slot of a worker
+    /// @param[in] worker - the worker owning the slot
+    /// @param[in] obj - the object
+    /// @param[in] destroy - function called on the worker thread at exit
+    void Bind(WorkerThread& worker, void* obj, void (*destroy)(void*)) const;
+
+private:
+    WorkerLocalBase(const WorkerLocalBase&) = delete;
+    WorkerLocalBase& operator=(const WorkerLocalBase&) = delete;
+
+    static size_t AllocateSlot();
+
+    const size_t m_slot;
+};
+
+/// A separate instance of T for each WorkerThread
+template <class T>
+class WorkerLocal : public WorkerLocalBase
+{
+public:
+    /// Constructor. Each worker's instance is default constructed.
+    WorkerLocal() : m_factory([]() { return new T(); }) {}
+
+    /// Constructor
+    /// @param[in] factory - creates a worker's instance on first access
+    explicit WorkerLocal(std::function<T*()> factory) : m_factory(std::move(factory)) {}
+
+    /// Get the calling worker thread's instance
+    /// @return The current worker's instance
+    T& Get()
+    {
+        WorkerThread* worker = WorkerThread::GetCurrentWorker();
+        ASSERT_TRUE(worker != nullptr);
+        return Get(*worker);
+    }
+
+    /// Get a worker's instance. Only call from that worker's thread.
+    /// @param[in] worker - the calling worker thread
+    /// @return The worker's instance
+    T& Get(WorkerThread& worker)
+    {
+        void* obj = Find(worker);
+        if (obj == nullptr)
+        {
+            obj = m_factory();
+            ASSERT_TRUE(obj != nullptr);
+            Bind(worker, obj, [](void* p) { delete static_cast<T*>(p); });
+        }
+        return *static_cast<T*>(obj);
+    }
+
+    T* operator->() { return &Get(); }
+    T& operator*() { return Get(); }
+
+private:
+    std::function<T*()> m_factory;
+};
+
+#endif
@@ -0,0 +1,262 @@
+#ifndef _WORKER_SCHEDULER_H
+#define _WORKER_SCHEDULER_H
+
+// Sender/receiver (P2300 std::execution style) scheduler adapter for WorkerThread.
+//
+// schedule(worker) returns a sender that completes with set_value() on the
+// worker's event loop. connect(sender, receiver) returns an operation state
+// that lives in the caller's frame; start(op) links it into the worker's
+// intrusive work list, so no memory is allocated per operation.
+//
+// The standard library shipped with the supported compilers has no
+// <execution> sender support, so the protocol is mirrored here with the same
+// names: a receiver provides set_value(), set_error(e) and set_stopped();
+// a sender provides connect(receiver); an operation state provides start().
+// set_stopped() is delivered if the worker exits before the operation runs.
+
+#include "WorkerThread.h"
+#include "Fault.h"
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+
+/// Operation state for a ScheduleSender. Not movable; must stay alive until
+/// the receiver is completed.
+template <class Receiver>
+class ScheduleOperation : public WorkItem
+{
+public:
+    ScheduleOperation(WorkerThread* worker, Receiver receiver) :
+        m_worker(worker), m_receiver(std::move(receiver)) {}
+
+    ScheduleOperation(const ScheduleOperation&) = delete;
+    ScheduleOperation& operator=(const ScheduleOperation&) = delete;
+
+    /// Enqueue the operation on the worker thread
+    void start() noexcept { m_worker->PostWork(this); }
+
+private:
+    void Execute() override { m_receiver.set_value(); }
+    void Abandon() override { m_receiver.set_stopped(); }
+
+    WorkerThread* m_worker;
+    Receiver m_receiver;
+};
+
+/// Sender that completes on a worker thread
+class ScheduleSender
+{
+public:
+    explicit ScheduleSender(WorkerThread* worker) : m_worker(worker) {}
+
+    template <class Receiver>
+    ScheduleOperation<Receiver> connect(Receiver receiver) const
+    {
+        return ScheduleOperation<Receiver>(m_worker, std::move(receiver));
+    }
+
+private:
+    WorkerThread* m_worker;
+};
+
+/// Scheduler handle for a WorkerThread. Cheap to copy.
+class WorkerScheduler
+{
+public:
+    explicit WorkerScheduler(WorkerThread& worker) : m_worker(&worker) {}
+
+    ScheduleSender schedule() const { return ScheduleSender(m_worker); }
+
+    bool operator==(const WorkerScheduler& other) const { return m_worker == other.m_worker; }
+    bool operator!=(const WorkerScheduler& other) const { return m_worker != other.m_worker; }
+
+private:
+    WorkerThread* m_worker;
+};
+
+/// A fixed group of worker threads used as the execution resource for bulk()
+template <size_t N>
+class WorkerGroup
+{
+public:
+    template <class... Workers>
+    explicit WorkerGroup(Workers&... workers) : m_workers{ { &workers... } }
+    {
+        static_assert(sizeof...(Workers) == N, "WorkerGroup size mismatch");
+    }
+
+    WorkerThread& operator[](size_t i) const { return *m_workers[i]; }
+    static constexpr size_t size() { return N; }
+
+private:
+    std::array<WorkerThread*, N> m_workers;
+};
+
+/// Operation state for a BulkSender. Holds one work item per worker inline.
+template <size_t N, class Function, class Receiver>
+class BulkOperation
+{
+public:
+    BulkOperation(const WorkerGroup<N>& group, size_t shape, Function function, Receiver receiver) :
+        m_group(group), m_shape(shape), m_function(std::move(function)), m_receiver(std::move(receiver))
+    {
+        for (size_t i = 0; i < N; i++)
+            m_parts[i].Init(this, i);
+    }
+
+    BulkOperation(const BulkOperation&) = delete;
+    BulkOperation& operator=(const BulkOperation&) = delete;
+
+    /// Fan the index space out across the group, one contiguous range per worker
+    void start() noexcept
+    {
+        m_remaining.store(N, std::memory_order_relaxed);
+        m_stopped.store(false, std::memory_order_relaxed);
+        for (size_t i = 0; i < N; i++)
+            m_group[i].PostWork(&m_parts[i]);
+    }
+
+private:
+    class Part : public WorkItem
+    {
+    public:
+        void Init(BulkOperation* op, size_t index) { m_op = op; m_index = index; }
+
+    private:
+        void Execute() override
+        {
+            size_t begin = m_op->m_shape * m_index / N;
+            size_t end = m_op->m_shape * (m_index + 1) / N;
+            for (size_t i = begin; i < end; i++)
+                m_op->m_function(i);
+            m_op->Complete();
+        }
+
+        void Abandon() override
+        {
+            m_op->m_stopped.store(true, std::memory_order_relaxed);
+            m_op->Complete();
+        }
+
+        BulkOperation* m_op = nullptr;
+        size_t m_index = 0;
+    };
+
+    /// The last part to finish completes the receiver on its own worker
+    void Complete()
+    {
+        if (m_remaining.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        if (m_stopped.load(std::memory_order_relaxed))
+            m_receiver.set_stopped();
+        else
+            m_receiver.set_value();
+    }
+
+    WorkerGroup<N> m_group;
+    size_t m_shape;
+    Function m_function;
+    Receiver m_receiver;
+    std::atomic<size_t> m_remaining{0};
+    std::atomic<bool> m_stopped{false};
+    std::array<Part, N> m_parts;
+};
+
+/// Sender that invokes function(i) for i in [0, shape) across a worker group
+template <size_t N, class Function>
+class BulkSender
+{
+public:
+    BulkSender(const WorkerGroup<N>& group, size_t shape, Function function) :
+        m_group(group), m_shape(shape), m_function(std::move(function)) {}
+
+    template <class Receiver>
+    BulkOperation<N, Function, Receiver> connect(Receiver receiver) const
+    {
+        return BulkOperation<N, Function, Receiver>(m_group, m_shape, m_function, std::move(receiver));
+    }
+
+private:
+    WorkerGroup<N> m_group;
+    size_t m_shape;
+    Function m_function;
+};
+
+/// Get a sender that completes on a worker thread
+/// @param[in] worker - the worker thread
+/// @return The sender
+inline ScheduleSender schedule(WorkerThread& worker) { return ScheduleSender(&worker); }
+inline ScheduleSender schedule(const WorkerScheduler& scheduler) { return scheduler.schedule(); }
+
+/// Get a sender that runs function(i) for each index across a worker group
+/// @param[in] group - the worker threads to fan out across
+/// @param[in] shape - the number of indexes
+/// @param[in] function - invoked as function(size_t); must be safe to call concurrently
+/// @return The sender
+template <size_t N, class Function>
+BulkSender<N, Function> bulk(const WorkerGroup<N>& group, size_t shape, Function function)
+{
+    return BulkSender<N, Function>(group, shape, std::move(function));
+}
+
+/// Connect a sender to a receiver
+template <class Sender, class Receiver>
+auto connect(const Sender& sender, Receiver receiver) -> decltype(sender.connect(std::move(receiver)))
+{
+    return sender.connect(std::move(receiver));
+}
+
+/// Start an operation state
+template <class Operation>
+auto start(Operation& operation) noexcept -> decltype(operation.start())
+{
+    operation.start();
+}
+
+/// Completion state shared between sync_wait() and its receiver
+struct SyncWaitState
+{
+    std::mutex lock;
+    std::condition_variable cv;
+    bool done = false;
+    bool value = false;
+
+    void Signal(bool completedWithValue)
+    {
+        std::lock_guard<std::mutex> lk(lock);
+        value = completedWithValue;
+        done = true;
+        cv.notify_one();
+    }
+};
+
+/// Receiver used by sync_wait()
+struct SyncWaitReceiver
+{
+    SyncWaitState* state;
+
+    void set_value() { state->Signal(true); }
+    template <class E> void set_error(E&&) { state->Signal(false); }
+    void set_stopped() { state->Signal(false); }
+};
+
+/// Block the calling thread until a sender completes. Must not be called
+/// from a worker thread the sender completes on.
+/// @param[in] sender - the sender
+/// @return True if completed with a value, false if stopped or failed
+template <class Sender>
+bool sync_wait(const Sender& sender)
+{
+    SyncWaitState state;
+    auto operation = connect(sender, SyncWaitReceiver{ &state });
+    start(operation);
+
+    std::unique_lock<std::mutex> lk(state.lock);
+    state.cv.wait(lk, [&state] { return state.done; });
+    return state.value;
+}
+
+#endif
@@ -1,9 +1,22 @@
 #include "WorkerThread.h"
 #include "Fault.h"
+#include "ConfigBroadcast.h"
+#include "TokenBucket.h"
+#include "SpillFile.h"
+#include "Profiler.h"
+#include "TscClock.h"
+#include "Tracer.h"
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <cstring>
 
 #ifdef WIN32
 #include <Windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
 #endif
 
 using namespace std;
@@ -11,18 +24,102 @@ using namespace std;
 #define MSG_EXIT_THREAD			1
 #define MSG_POST_USER_DATA		2
 #define MSG_TIMER				3
+#define MSG_TASK				4
+#define MSG_SLICED_TASK			5
+
+static_assert(MSG_SLICED_TASK < WorkerThread::MSG_ID_COUNT, "QueueSnapshot must count every message id");
+
+static thread_local WorkerThread* t_currentWorker = nullptr;
 
 struct ThreadMsg
 {
 	ThreadMsg(int i, std::shared_ptr<void> m) { id = i; msg = m; }
 	int id;
     std::shared_ptr<void> msg;
+	std::stop_token token;
+	std::chrono::steady_clock::time_point deadline;
+	bool hasDeadline = false;
+	uint64_t seq = 0;
+	uint64_t enqueueTime = 0;	// TscClock ticks
+	size_t bytes = 0;
+	TraceContext trace;
+};
+
+// Spill file record kinds
+#define SPILL_USER_DATA			1
+#define SPILL_RESIDENT			2
+
+namespace
+{
+	// Join the posting handler's trace or begin a sampled root. Internal
+	// timer and exit messages are not traced.
+	void StampTrace(ThreadMsg& msg)
+	{
+		if (Tracer::IsEnabled() && msg.trace.spanId == 0 && msg.id != MSG_TIMER && msg.id != MSG_EXIT_THREAD)
+			msg.trace = Tracer::NewContext();
+	}
+
+	// Approximate heap footprint of a queued message
+	size_t MessageBytes(const ThreadMsg& msg)
+	{
+		size_t bytes = sizeof(ThreadMsg);
+		if (msg.id == MSG_POST_USER_DATA && msg.msg)
+			bytes += sizeof(UserData) + static_cast<const UserData*>(msg.msg.get())->msg.capacity();
+		else if (msg.msg)
+			bytes += sizeof(std::function<void()>);
+		return bytes;
+	}
+
+	// Spill record header for a user data message, followed by the text
+	struct SpilledUserData
+	{
+		uint8_t kind;
+		int32_t year;
+		uint64_t enqueueTime;
+		uint64_t bytes;     // Footprint counted at enqueue, so pop subtracts the same
+	};
+}
+
+struct RateLimit
+{
+	RateLimit(double rate, uint32_t burst, WorkerThread::RateLimitPolicy p) : bucket(rate, burst), policy(p) {}
+
+	TokenBucket bucket;
+	const WorkerThread::RateLimitPolicy policy;
+
+	/// Messages waiting for tokens under the DEFER policy, oldest first
+	std::atomic<size_t> deferredCount{0};
+	std::mutex deferredMutex;
+	std::deque<std::shared_ptr<ThreadMsg>> deferred;
+};
+
+struct Watermark
+{
+	size_t high;
+	size_t low;
+	std::function<void()> onHigh;
+	std::function<void()> onLow;
+	WorkerThread* notifyThread;
+
+	/// Current state, updated under the watched thread's m_mutex
+	std::atomic<bool> above{false};
+
+	/// Last state reported. Only accessed by the notify thread.
+	bool delivered = false;
 };
 
 //----------------------------------------------------------------------------
 // WorkerThread
 //----------------------------------------------------------------------------
-WorkerThread::WorkerThread(const std::string& threadName) : m_thread(nullptr), m_timerExit(false), THREAD_NAME(threadName)
+WorkerThread::WorkerThread(const std::string& threadName) : m_thread(nullptr), m_highPending(false),
+	m_queueMode(QueueMode::FIFO), m_defaultDeadline(1s), m_enqueueSeq(0), m_edfExitSeq(0), m_edfExitAhead(0), m_deadlineDispatched(0), m_deadlineMissed(0),
+	m_codelTarget(0), m_codelInterval(100ms), m_codelTargetTicks(0), m_codelCount(0), m_codelDropping(false), m_dropped(0), m_dropEpisodes(0), m_deferredWake(false), m_queueDepth(0),
+	m_pendingBytes(0), m_oldestEnqueue(0), m_snapshotDetail(false),
+	m_spillThreshold(0), m_queueBytes(0), m_spilledCount(0), m_spillWrites(0), m_spillFallbacks(0),
+	m_workHead(nullptr), m_workTail(nullptr),
+	m_workClosed(false), m_preferWork(false), m_timerExit(false),
+	m_timerInterval(250ms), m_timerMode(TimerMode::SLEEP_FOR), m_timerPriority(Priority::NORMAL), m_configVersion(0), m_cpuAffinity(-1),
+	m_statsSlot(nullptr), m_statsDispatched(0), m_statsBusyTicks(0), m_statsDispatchStart(0), m_timeSlice(10ms), m_timeSliceTicks(0), m_sliceDeadline(0), m_yieldChecks(0), THREAD_NAME(threadName)
 {
 }
 
@@ -41,6 +138,8 @@ bool WorkerThread::CreateThread()
 {
 	if (!m_thread)
 	{
+		m_workClosed = false;
+		m_statsSlot = StatsSegment::AcquireSlot(THREAD_NAME);
 		m_thread = std::unique_ptr<std::thread>(new thread(&WorkerThread::Process, this));
 
 #ifdef WIN32
@@ -55,11 +154,35 @@ bool WorkerThread::CreateThread()
 			// Handle error if needed
 		}
 #endif
+
+		if (m_cpuAffinity >= 0)
+			SetThreadAffinity(*m_thread, m_cpuAffinity);
 	}
 
 	return true;
 }
 
+//----------------------------------------------------------------------------
+// SetThreadAffinity
+//----------------------------------------------------------------------------
+bool WorkerThread::SetThreadAffinity(std::thread& thread, int cpu)
+{
+	ASSERT_TRUE(cpu >= 0);
+
+#ifdef WIN32
+	DWORD_PTR mask = static_cast<DWORD_PTR>(1) << cpu;
+	return SetThreadAffinityMask(thread.native_handle(), mask) != 0;
+#elif defined(__linux__)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+#else
+	(void)thread;
+	return false;
+#endif
+}
+
 //----------------------------------------------------------------------------
 // GetThreadId
 //----------------------------------------------------------------------------
@@ -77,6 +200,14 @@ std::thread::id WorkerThread::GetCurrentThreadId()
 	return this_thread::get_id();
 }
 
+//----------------------------------------------------------------------------
+// GetCurrentWorker
+//----------------------------------------------------------------------------
+WorkerThread* WorkerThread::GetCurrentWorker()
+{
+	return t_currentWorker;
+}
+
 //----------------------------------------------------------------------------
 // ExitThread
 //----------------------------------------------------------------------------
@@ -89,20 +220,22 @@ void WorkerThread::ExitThread()
 	std::shared_ptr<ThreadMsg> threadMsg(new ThreadMsg(MSG_EXIT_THREAD, 0));
 
 	// Put exit thread message into the queue
-	{
-		lock_guard<mutex> lock(m_mutex);
-		m_queue.push(threadMsg);
-		m_cv.notify_one();
-	}
+	Enqueue(threadMsg, Priority::NORMAL);
 
     m_thread->join();
     m_thread = nullptr;
+
+	if (m_statsSlot)
+	{
+		StatsSegment::ReleaseSlot(m_statsSlot);
+		m_statsSlot = nullptr;
+	}
 }
 
 //----------------------------------------------------------------------------
 // PostMsg
 //----------------------------------------------------------------------------
-void WorkerThread::PostMsg(std::shared_ptr<UserData> data)
+void WorkerThread::PostMsg(std::shared_ptr<UserData> data, Priority priority)
 {
 	ASSERT_TRUE(m_thread);
 
@@ -110,9 +243,677 @@ void WorkerThread::PostMsg(std::shared_ptr<UserData> data)
     std::shared_ptr<ThreadMsg> threadMsg(new ThreadMsg(MSG_POST_USER_DATA, data));
 
 	// Add user data msg to queue and notify worker thread
-	std::unique_lock<std::mutex> lk(m_mutex);
-	m_queue.push(threadMsg);
+	Enqueue(threadMsg, priority);
+}
+
+//----------------------------------------------------------------------------
+// PostTask
+//----------------------------------------------------------------------------
+void WorkerThread::PostTask(std::function<void()> task, Priority priority)
+{
+	ASSERT_TRUE(m_thread);
+	ASSERT_TRUE(task);
+
+	// Create a new ThreadMsg
+	std::shared_ptr<ThreadMsg> threadMsg(new ThreadMsg(MSG_TASK, std::make_shared<std::function<void()>>(std::move(task))));
+
+	// Add task msg to queue and notify worker thread
+	Enqueue(threadMsg, priority);
+}
+
+//----------------------------------------------------------------------------
+// PostTask
+//----------------------------------------------------------------------------
+void WorkerThread::PostTask(std::function<void()> task, std::stop_token token, Priority priority)
+{
+	ASSERT_TRUE(m_thread);
+	ASSERT_TRUE(task);
+
+	// Create a new ThreadMsg
+	std::shared_ptr<ThreadMsg> threadMsg(new ThreadMsg(MSG_TASK, std::make_shared<std::function<void()>>(std::move(task))));
+	threadMsg->token = std::move(token);
+
+	// Add task msg to queue and notify worker thread
+	Enqueue(threadMsg, priority);
+}
+
+//----------------------------------------------------------------------------
+// PostMsg
+//----------------------------------------------------------------------------
+void WorkerThread::PostMsg(std::shared_ptr<UserData> data, std::chrono::steady_clock::time_point deadline)
+{
+	ASSERT_TRUE(m_thread);
+
+	// Create a new ThreadMsg
+	std::shared_ptr<ThreadMsg> threadMsg(new ThreadMsg(MSG_POST_USER_DATA, data));
+	threadMsg->deadline = deadline;
+	threadMsg->hasDeadline = true;
+
+	// Add user data msg to queue and notify worker thread
+	Enqueue(threadMsg, Priority::NORMAL);
+}
+
+//----------------------------------------------------------------------------
+// PostTask
+//----------------------------------------------------------------------------
+void WorkerThread::PostTask(std::function<void()> task, std::chrono::steady_clock::time_point deadline)
+{
+	ASSERT_TRUE(m_thread);
+	ASSERT_TRUE(task);
+
+	// Create a new ThreadMsg
+	std::shared_ptr<ThreadMsg> threadMsg(new ThreadMsg(MSG_TASK, std::make_shared<std::function<void()>>(std::move(task))));
+	threadMsg->deadline = deadline;
+	threadMsg->hasDeadline = true;
+
+	// Add task msg to queue and notify worker thread
+	Enqueue(threadMsg, Priority::NORMAL);
+}
+
+//----------------------------------------------------------------------------
+// GetDeadlineStats
+//----------------------------------------------------------------------------
+WorkerThread::DeadlineStats WorkerThread::GetDeadlineStats() const
+{
+	DeadlineStats stats;
+	stats.dispatched = m_deadlineDispatched.load(std::memory_order_relaxed);
+	stats.missed = m_deadlineMissed.load(std::memory_order_relaxed);
+	return stats;
+}
+
+//----------------------------------------------------------------------------
+// SetCoDel
+//----------------------------------------------------------------------------
+void WorkerThread::SetCoDel(std::chrono::microseconds target, std::chrono::microseconds interval)
+{
+	ASSERT_TRUE(!m_thread);
+	ASSERT_TRUE(interval.count() > 0);
+	m_codelTarget = target;
+	m_codelInterval = interval;
+	m_codelTargetTicks = TscClock::FromNanoseconds(static_cast<uint64_t>(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(target).count()));
+}
+
+//----------------------------------------------------------------------------
+// GetDropStats
+//----------------------------------------------------------------------------
+WorkerThread::DropStats WorkerThread::GetDropStats() const
+{
+	DropStats stats;
+	stats.dropped = m_dropped.load(std::memory_order_relaxed);
+	stats.episodes = m_dropEpisodes.load(std::memory_order_relaxed);
+	return stats;
+}
+
+//----------------------------------------------------------------------------
+// GetQueueSnapshot
+//----------------------------------------------------------------------------
+WorkerThread::QueueSnapshot WorkerThread::GetQueueSnapshot() const
+{
+	QueueSnapshot snapshot;
+	snapshot.depth = m_queueDepth.load(std::memory_order_relaxed);
+	for (int id = 0; id < MSG_ID_COUNT; id++)
+		snapshot.pendingById[id] = m_pendingById[id].load(std::memory_order_relaxed);
+	snapshot.bytes = m_pendingBytes.load(std::memory_order_relaxed);
+
+	// The head may have been stamped on another core with a slightly later counter
+	uint64_t oldest = m_oldestEnqueue.load(std::memory_order_relaxed);
+	uint64_t now = TscClock::Now();
+	snapshot.oldestAge = std::chrono::nanoseconds(oldest != 0 && now > oldest ? TscClock::ToNanoseconds(now - oldest) : 0);
+	return snapshot;
+}
+
+//----------------------------------------------------------------------------
+// SetRateLimit
+//----------------------------------------------------------------------------
+void WorkerThread::SetRateLimit(int key, double rate, uint32_t burst, RateLimitPolicy policy)
+{
+	ASSERT_TRUE(!m_thread);
+	m_rateLimits[key] = std::unique_ptr<RateLimit>(new RateLimit(rate, burst, policy));
+}
+
+//----------------------------------------------------------------------------
+// PostMsg
+//----------------------------------------------------------------------------
+bool WorkerThread::PostMsg(std::shared_ptr<UserData> data, int key)
+{
+	ASSERT_TRUE(m_thread);
+
+	auto it = m_rateLimits.find(key);
+	ASSERT_TRUE(it != m_rateLimits.end());
+	RateLimit& limit = *it->second;
+
+	// Create a new ThreadMsg
+	std::shared_ptr<ThreadMsg> threadMsg(new ThreadMsg(MSG_POST_USER_DATA, data));
+
+	switch (limit.policy)
+	{
+		case RateLimitPolicy::REJECT:
+			if (!limit.bucket.TryAcquire())
+				return false;
+			break;
+
+		case RateLimitPolicy::BLOCK:
+			while (!limit.bucket.TryAcquire())
+				std::this_thread::sleep_for(limit.bucket.TimeUntilAvailable());
+			break;
+
+		case RateLimitPolicy::DEFER:
+			// Queue behind messages already deferred so the key stays in order
+			if (limit.deferredCount.load(std::memory_order_acquire) == 0 && limit.bucket.TryAcquire())
+				break;
+			// The trace parent is the poster, not the timer tick that releases it
+			StampTrace(*threadMsg);
+			size_t deferred;
+			{
+				std::lock_guard<std::mutex> lk(limit.deferredMutex);
+				limit.deferred.push_back(std::move(threadMsg));
+				deferred = limit.deferredCount.fetch_add(1, std::memory_order_release);
+			}
+
+			// The worker times its next wait to the first deferred token
+			if (deferred == 0)
+			{
+				std::lock_guard<InstrumentedMutex> lk(m_mutex);
+				m_deferredWake.store(true, std::memory_order_relaxed);
+				m_cv.notify_one();
+			}
+			return true;
+	}
+
+	// Add user data msg to queue and notify worker thread
+	Enqueue(threadMsg, Priority::NORMAL);
+	return true;
+}
+
+//----------------------------------------------------------------------------
+// ReleaseDeferred
+//----------------------------------------------------------------------------
+std::chrono::nanoseconds WorkerThread::ReleaseDeferred()
+{
+	auto next = std::chrono::nanoseconds::max();
+	for (auto& entry : m_rateLimits)
+	{
+		RateLimit& limit = *entry.second;
+		if (limit.deferredCount.load(std::memory_order_acquire) == 0)
+			continue;
+
+		std::lock_guard<std::mutex> lk(limit.deferredMutex);
+		while (!limit.deferred.empty() && limit.bucket.TryAcquire())
+		{
+			Enqueue(std::move(limit.deferred.front()), Priority::NORMAL);
+			limit.deferred.pop_front();
+			limit.deferredCount.fetch_sub(1, std::memory_order_release);
+		}
+		if (!limit.deferred.empty())
+			next = std::min(next, limit.bucket.TimeUntilAvailable());
+	}
+	return next;
+}
+
+//----------------------------------------------------------------------------
+// SetWatermarks
+//----------------------------------------------------------------------------
+void WorkerThread::SetWatermarks(size_t high, size_t low, std::function<void()> onHigh, std::function<void()> onLow,
+	WorkerThread& notifyThread)
+{
+	ASSERT_TRUE(!m_thread);
+	ASSERT_TRUE(low < high);
+	ASSERT_TRUE(onHigh && onLow);
+
+	m_watermark = std::make_shared<Watermark>();
+	m_watermark->high = high;
+	m_watermark->low = low;
+	m_watermark->onHigh = std::move(onHigh);
+	m_watermark->onLow = std::move(onLow);
+	m_watermark->notifyThread = &notifyThread;
+}
+
+//----------------------------------------------------------------------------
+// UpdateDepthLocked
+//----------------------------------------------------------------------------
+bool WorkerThread::UpdateDepthLocked(int id, size_t bytes, bool push)
+{
+	size_t depth = m_queueDepth.load(std::memory_order_relaxed);
+	depth = push ? depth + 1 : depth - 1;
+	m_queueDepth.store(depth, std::memory_order_relaxed);
+
+	// Writers are serialized by m_mutex; only GetQueueSnapshot() is concurrent
+	size_t count = m_pendingById[id].load(std::memory_order_relaxed);
+	m_pendingById[id].store(push ? count + 1 : count - 1, std::memory_order_relaxed);
+	uint64_t total = m_pendingBytes.load(std::memory_order_relaxed);
+	m_pendingBytes.store(push ? total + bytes : total - bytes, std::memory_order_relaxed);
+
+	// Each queue is ordered, so the oldest message is at one of the heads.
+	// Spilled messages are newer than every resident one, so once the last
+	// resident message is popped, bring the spill head into memory.
+	if (m_snapshotDetail)
+	{
+		if (m_queue.empty() && m_spilledCount > 0)
+			RefillLocked();
+		uint64_t oldest = 0;
+		auto consider = [&oldest](const std::shared_ptr<ThreadMsg>& head) {
+			if (oldest == 0 || head->enqueueTime < oldest)
+				oldest = head->enqueueTime;
+		};
+		if (!m_highQueue.empty())
+			consider(m_highQueue.front());
+		if (!m_queue.empty())
+			consider(m_queue.front());
+		if (!m_edfQueue.Empty())
+			consider(m_edfQueue.Top());
+		m_oldestEnqueue.store(oldest, std::memory_order_relaxed);
+	}
+
+	if (!m_watermark)
+		return false;
+
+	// Hysteresis: only a rise to high or a fall to low changes state
+	bool above = m_watermark->above.load(std::memory_order_relaxed);
+	if (above ? depth > m_watermark->low : depth < m_watermark->high)
+		return false;
+	m_watermark->above.store(!above, std::memory_order_release);
+	return true;
+}
+
+//----------------------------------------------------------------------------
+// NotifyWatermark
+//----------------------------------------------------------------------------
+void WorkerThread::NotifyWatermark()
+{
+	// Notifications posted outside the lock may arrive out of order, so the
+	// notify thread reports the current state rather than the crossing
+	std::shared_ptr<Watermark> watermark = m_watermark;
+	watermark->notifyThread->PostTask([watermark]() {
+		bool above = watermark->above.load(std::memory_order_acquire);
+		if (above == watermark->delivered)
+			return;
+		watermark->delivered = above;
+		if (above)
+			watermark->onHigh();
+		else
+			watermark->onLow();
+	});
+}
+
+//----------------------------------------------------------------------------
+// SetSpill
+//----------------------------------------------------------------------------
+bool WorkerThread::SetSpill(size_t threshold, const std::string& directory, size_t maxFileBytes)
+{
+	ASSERT_TRUE(!m_thread);
+
+	std::unique_ptr<SpillFile> spill(new SpillFile());
+	if (!spill->Open(directory, maxFileBytes))
+		return false;
+
+	m_spill = std::move(spill);
+	m_spillThreshold = threshold;
+	return true;
+}
+
+//----------------------------------------------------------------------------
+// GetSpillStats
+//----------------------------------------------------------------------------
+WorkerThread::SpillStats WorkerThread::GetSpillStats() const
+{
+	SpillStats stats;
+	stats.spilled = m_spillWrites.load(std::memory_order_relaxed);
+	stats.fallbacks = m_spillFallbacks.load(std::memory_order_relaxed);
+	return stats;
+}
+
+//----------------------------------------------------------------------------
+// SpillLocked
+//----------------------------------------------------------------------------
+void WorkerThread::SpillLocked(std::shared_ptr<ThreadMsg> msg)
+{
+	m_spilledCount++;
+
+	// Once the file has refused a message, later ones queue behind it in
+	// memory so order is kept
+	if (!m_spillOverflow.empty())
+	{
+		m_spillOverflow.push(std::move(msg));
+		m_spillFallbacks.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	std::string record;
+	bool resident = false;
+	if (msg->id == MSG_POST_USER_DATA && !msg->hasDeadline && msg->trace.traceId == 0)
+	{
+		auto userData = std::static_pointer_cast<UserData>(msg->msg);
+		SpilledUserData header = {};
+		header.kind = SPILL_USER_DATA;
+		header.year = userData->year;
+		header.enqueueTime = msg->enqueueTime;
+		header.bytes = msg->bytes;
+		record.resize(sizeof(header) + userData->msg.size());
+		memcpy(&record[0], &header, sizeof(header));
+		memcpy(&record[sizeof(header)], userData->msg.data(), userData->msg.size());
+	}
+	else
+	{
+		// Keep the message in memory; the record holds its place in the order
+		record.assign(1, static_cast<char>(SPILL_RESIDENT));
+		resident = true;
+	}
+
+	// A full file or failed growth must not take down an overloaded process
+	if (!m_spill->Write(record.data(), record.size()))
+	{
+		m_spillOverflow.push(std::move(msg));
+		m_spillFallbacks.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	if (resident)
+		m_spillResident.push(std::move(msg));
+	m_spillWrites.fetch_add(1, std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------------
+// RefillLocked
+//----------------------------------------------------------------------------
+void WorkerThread::RefillLocked()
+{
+	// Refill half the threshold at a time, at least one message
+	std::string record;
+	do
+	{
+		m_spilledCount--;
+
+		// Overflow messages are newer than every record in the file
+		std::shared_ptr<ThreadMsg> msg;
+		if (m_spill->Empty())
+		{
+			msg = std::move(m_spillOverflow.front());
+			m_spillOverflow.pop();
+			m_queueBytes += msg->bytes;
+			m_queue.push(std::move(msg));
+			continue;
+		}
+
+		m_spill->Read(record);
+		if (record[0] == SPILL_RESIDENT)
+		{
+			msg = std::move(m_spillResident.front());
+			m_spillResident.pop();
+		}
+		else
+		{
+			SpilledUserData header;
+			memcpy(&header, record.data(), sizeof(header));
+			auto userData = std::make_shared<UserData>();
+			userData->year = header.year;
+			userData->msg.assign(record, sizeof(header), std::string::npos);
+			msg = std::make_shared<ThreadMsg>(MSG_POST_USER_DATA, userData);
+			msg->enqueueTime = header.enqueueTime;
+			msg->bytes = static_cast<size_t>(header.bytes);
+		}
+
+		m_queueBytes += msg->bytes;
+		m_queue.push(std::move(msg));
+	} while (m_spilledCount > 0 && m_queueBytes < m_spillThreshold / 2);
+}
+
+//----------------------------------------------------------------------------
+// PostSlicedTask
+//----------------------------------------------------------------------------
+void WorkerThread::PostSlicedTask(std::function<bool()> slice)
+{
+	ASSERT_TRUE(m_thread);
+	ASSERT_TRUE(slice);
+
+	// Create a new ThreadMsg
+	std::shared_ptr<ThreadMsg> threadMsg(new ThreadMsg(MSG_SLICED_TASK, std::make_shared<std::function<bool()>>(std::move(slice))));
+
+	// Add sliced task msg to queue and notify worker thread
+	Enqueue(threadMsg, Priority::NORMAL);
+}
+
+//----------------------------------------------------------------------------
+// Enqueue
+//----------------------------------------------------------------------------
+void WorkerThread::Enqueue(std::shared_ptr<ThreadMsg> msg, Priority priority)
+{
+	// Messages without an explicit deadline, including requeued slices, get
+	// the default relative deadline
+	if (m_queueMode == QueueMode::EDF && priority == Priority::NORMAL && !msg->hasDeadline)
+		msg->deadline = std::chrono::steady_clock::now() + m_defaultDeadline;
+
+	StampTrace(*msg);
+
+	// Sojourn time is measured from here to dequeue. Only pay for the clock
+	// read and size walk when something consumes them.
+	if (m_snapshotDetail || (m_codelTarget.count() > 0 && priority == Priority::NORMAL) || m_statsSlot || msg->trace.traceId != 0)
+		msg->enqueueTime = TscClock::Now();
+	if (m_snapshotDetail || (m_spill && priority == Priority::NORMAL))
+		msg->bytes = MessageBytes(*msg);
+
+	// A spilled message is destroyed once written, so keep what the counters need
+	int id = msg->id;
+	size_t bytes = msg->bytes;
+
+	std::unique_lock<InstrumentedMutex> lk(m_mutex);
+	if (priority == Priority::HIGH)
+	{
+		m_highQueue.push(std::move(msg));
+		m_highPending.store(true, std::memory_order_relaxed);
+	}
+	else if (m_queueMode == QueueMode::EDF && msg->id == MSG_EXIT_THREAD)
+	{
+		// Exit must follow every message posted before it, whatever their
+		// deadlines, but not later posts, so it waits outside the heap until
+		// the messages already queued have drained
+		m_edfExit = std::move(msg);
+		m_edfExitSeq = m_enqueueSeq;
+		m_edfExitAhead = m_edfQueue.Size();
+	}
+	else if (m_queueMode == QueueMode::EDF)
+	{
+		msg->seq = m_enqueueSeq++;
+		m_edfQueue.Push(std::move(msg));
+	}
+	else if (m_spill && (m_spilledCount > 0 || m_queueBytes + msg->bytes > m_spillThreshold))
+	{
+		// Once spilling, everything goes through the spill until it drains
+		SpillLocked(std::move(msg));
+	}
+	else
+	{
+		m_queueBytes += msg->bytes;
+		m_queue.push(std::move(msg));
+	}
+	bool crossed = UpdateDepthLocked(id, bytes, true);
 	m_cv.notify_one();
+	lk.unlock();
+
+	if (crossed)
+		NotifyWatermark();
+}
+
+//----------------------------------------------------------------------------
+// PopNormalLocked
+//----------------------------------------------------------------------------
+std::shared_ptr<ThreadMsg> WorkerThread::PopNormalLocked()
+{
+	if (m_edfExit && m_edfExitAhead == 0)
+		return std::move(m_edfExit);
+
+	if (!m_edfQueue.Empty())
+	{
+		std::shared_ptr<ThreadMsg> msg = m_edfQueue.Pop();
+		if (m_edfExit && msg->seq < m_edfExitSeq)
+			m_edfExitAhead--;
+		return msg;
+	}
+
+	if (m_queue.empty())
+		RefillLocked();
+
+	std::shared_ptr<ThreadMsg> msg = m_queue.front();
+	m_queue.pop();
+	m_queueBytes -= msg->bytes;
+	return msg;
+}
+
+//----------------------------------------------------------------------------
+// CoDelShouldDrop
+//----------------------------------------------------------------------------
+bool WorkerThread::CoDelShouldDrop(const ThreadMsg& msg, std::chrono::steady_clock::time_point now)
+{
+	// Interval between drops shrinks with the square root of the drop count
+	auto controlLaw = [this](std::chrono::steady_clock::time_point t) {
+		return t + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			m_codelInterval / std::sqrt(static_cast<double>(m_codelCount)));
+	};
+
+	// Delay is only "standing" if it persists for a whole interval. An empty
+	// queue means any backlog has drained.
+	// Sojourn is measured in clock ticks. Enqueue on another core may read a
+	// slightly later counter, so compare signed.
+	bool okToDrop = false;
+	int64_t sojourn = static_cast<int64_t>(TscClock::Now() - msg.enqueueTime);
+	if (sojourn < static_cast<int64_t>(m_codelTargetTicks) || NormalEmptyLocked())
+	{
+		m_codelFirstAbove = std::chrono::steady_clock::time_point();
+	}
+	else if (m_codelFirstAbove == std::chrono::steady_clock::time_point())
+	{
+		m_codelFirstAbove = now + m_codelInterval;
+	}
+	else if (now >= m_codelFirstAbove)
+	{
+		okToDrop = true;
+	}
+
+	if (!okToDrop)
+	{
+		m_codelDropping = false;
+		return false;
+	}
+
+	// Only user data may be shed; tasks may own promises or group references
+	if (msg.id != MSG_POST_USER_DATA)
+		return false;
+
+	if (m_codelDropping)
+	{
+		if (now < m_codelDropNext)
+			return false;
+		m_codelCount++;
+		m_codelDropNext = controlLaw(m_codelDropNext);
+		return true;
+	}
+
+	// Enter the dropping state. Resume near the previous rate if the last
+	// episode ended recently.
+	m_codelDropping = true;
+	m_dropEpisodes.fetch_add(1, std::memory_order_relaxed);
+	if (m_codelCount > 2 && now - m_codelDropNext < 8 * m_codelInterval)
+		m_codelCount -= 2;
+	else
+		m_codelCount = 1;
+	m_codelDropNext = controlLaw(now);
+	return true;
+}
+
+//----------------------------------------------------------------------------
+// StatsBegin
+//----------------------------------------------------------------------------
+void WorkerThread::StatsBegin(int id, uint64_t enqueueTime)
+{
+	// Timings stay in clock ticks until PublishStats()
+	m_statsDispatchStart = TscClock::Now();
+	if (id != -1 && m_statsDispatchStart > enqueueTime)
+		m_waitWindow.Record(m_statsDispatchStart - enqueueTime);
+	StatsSegment::SetCurrentMsgId(m_statsSlot, id);
+}
+
+//----------------------------------------------------------------------------
+// StatsEnd
+//----------------------------------------------------------------------------
+void WorkerThread::StatsEnd()
+{
+	m_statsBusyTicks += TscClock::Now() - m_statsDispatchStart;
+	m_statsDispatched++;
+	StatsSegment::SetCurrentMsgId(m_statsSlot, 0);
+}
+
+//----------------------------------------------------------------------------
+// PublishStats
+//----------------------------------------------------------------------------
+void WorkerThread::PublishStats()
+{
+	WorkerStats stats = {};
+	stats.queueDepth = m_queueDepth.load(std::memory_order_relaxed);
+	stats.dispatched = m_statsDispatched;
+	stats.busyNs = TscClock::ToNanoseconds(m_statsBusyTicks);
+	stats.waitP50Ns = TscClock::ToNanoseconds(m_waitWindow.Percentile(50));
+	stats.waitP99Ns = TscClock::ToNanoseconds(m_waitWindow.Percentile(99));
+	InstrumentedMutex::Stats lock = m_mutex.GetStats();
+	stats.lockAcquired = lock.acquired;
+	stats.lockContended = lock.contended;
+	stats.lockWaitNs = lock.waitNs;
+	stats.lockHoldNs = lock.holdNs;
+	stats.timestampNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count());
+	StatsSegment::Publish(m_statsSlot, stats);
+	m_waitWindow.Reset();
+}
+
+//----------------------------------------------------------------------------
+// DeadlineLess
+//----------------------------------------------------------------------------
+bool WorkerThread::DeadlineLess::operator()(const std::shared_ptr<ThreadMsg>& a, const std::shared_ptr<ThreadMsg>& b) const
+{
+	if (a->deadline != b->deadline)
+		return a->deadline < b->deadline;
+	return a->seq < b->seq;
+}
+
+//----------------------------------------------------------------------------
+// ShouldYield
+//----------------------------------------------------------------------------
+bool WorkerThread::ShouldYield()
+{
+	if (m_highPending.load(std::memory_order_relaxed))
+		return true;
+
+	// Sampling the clock on every call would dominate a tight loop
+	if (++m_yieldChecks % YIELD_CLOCK_STRIDE != 0)
+		return false;
+
+	return TscClock::Now() >= m_sliceDeadline;
+}
+
+//----------------------------------------------------------------------------
+// PostWork
+//----------------------------------------------------------------------------
+void WorkerThread::PostWork(WorkItem* item)
+{
+	ASSERT_TRUE(m_thread);
+	ASSERT_TRUE(item != nullptr);
+
+	{
+		std::unique_lock<InstrumentedMutex> lk(m_mutex);
+		if (!m_workClosed)
+		{
+			// Append to the intrusive work list and notify worker thread
+			item->m_next = nullptr;
+			if (m_workTail)
+				m_workTail->m_next = item;
+			else
+				m_workHead = item;
+			m_workTail = item;
+			m_cv.notify_one();
+			return;
+		}
+	}
+
+	// Worker thread is exiting
+	item->Abandon();
 }
 
 //----------------------------------------------------------------------------
@@ -120,20 +921,60 @@ void WorkerThread::PostMsg(std::shared_ptr<UserData> data)
 //----------------------------------------------------------------------------
 void WorkerThread::TimerThread()
 {
+    // Ticks are scheduled on a fixed grid from here; SLEEP_FOR drifts from it
+    auto scheduled = std::chrono::steady_clock::now() + m_timerInterval;
     while (!m_timerExit)
     {
-        // Sleep for 250mS then put a MSG_TIMER into the message queue
-        std::this_thread::sleep_for(250ms);
+        // Sleep for the timer interval then put a MSG_TIMER into the message queue
+        if (m_timerMode == TimerMode::SLEEP_UNTIL)
+            std::this_thread::sleep_until(scheduled);
+        else
+            std::this_thread::sleep_for(m_timerInterval);
 
-        std::shared_ptr<ThreadMsg> threadMsg (new ThreadMsg(MSG_TIMER, 0));
+        std::shared_ptr<ThreadMsg> threadMsg (new ThreadMsg(MSG_TIMER,
+            std::make_shared<std::chrono::steady_clock::time_point>(scheduled)));
+        scheduled += m_timerInterval;
 
         // Add timer msg to queue and notify worker thread
-        std::unique_lock<std::mutex> lk(m_mutex);
-        m_queue.push(threadMsg);
-        m_cv.notify_one();
+        Enqueue(threadMsg, m_timerPriority);
     }
 }
 
+//----------------------------------------------------------------------------
+// DestroyLocals
+//----------------------------------------------------------------------------
+void WorkerThread::DestroyLocals()
+{
+	// Destroy in reverse slot order, mirroring static destruction
+	for (auto it = m_localSlots.rbegin(); it != m_localSlots.rend(); ++it)
+	{
+		if (it->obj)
+			it->destroy(it->obj);
+	}
+	m_localSlots.clear();
+}
+
+//----------------------------------------------------------------------------
+// AbandonWork
+//----------------------------------------------------------------------------
+void WorkerThread::AbandonWork()
+{
+	WorkItem* item;
+	{
+		std::unique_lock<InstrumentedMutex> lk(m_mutex);
+		m_workClosed = true;
+		item = m_workHead;
+		m_workHead = m_workTail = nullptr;
+	}
+
+	while (item)
+	{
+		WorkItem* next = item->m_next;
+		item->Abandon();
+		item = next;
+	}
+}
+
 //----------------------------------------------------------------------------
 // Process
 //----------------------------------------------------------------------------
@@ -141,21 +982,135 @@ void WorkerThread::Process()
 {
     m_timerExit = false;
     std::thread timerThread(&WorkerThread::TimerThread, this);
+	t_currentWorker = this;
+	Profiler::RegisterThread(THREAD_NAME);
+	m_timeSliceTicks = TscClock::FromNanoseconds(static_cast<uint64_t>(
+		std::chrono::duration_cast<std::chrono::nanoseconds>(m_timeSlice).count()));
+
+	Qsbr& qsbr = Qsbr::Instance();
+	qsbr.Register(&m_qsbrRecord);
 
 	while (1)
 	{
 		std::shared_ptr<ThreadMsg> msg;
+		WorkItem* work = nullptr;
+		bool drop = false;
+		bool crossed = false;
+
+		// Release deferred messages as their tokens become available. A post
+		// that starts deferring after this sets m_deferredWake.
+		auto deferredWait = std::chrono::nanoseconds::max();
+		if (!m_rateLimits.empty())
+		{
+			m_deferredWake.store(false, std::memory_order_relaxed);
+			deferredWait = ReleaseDeferred();
+		}
+
+		{
+			// Wait for a message or work item to be added to the queue
+			std::unique_lock<InstrumentedMutex> lk(m_mutex);
+			if (NormalEmptyLocked() && m_highQueue.empty() && m_workHead == nullptr)
+			{
+				// An idle worker holds no RCU references so must not stall reclamation
+				qsbr.Offline(&m_qsbrRecord);
+				if (deferredWait != std::chrono::nanoseconds::max())
+				{
+					m_mutex.WaitFor(m_cv, deferredWait);
+				}
+				else
+				{
+					while (NormalEmptyLocked() && m_highQueue.empty() && m_workHead == nullptr &&
+						!m_deferredWake.load(std::memory_order_relaxed))
+						m_mutex.Wait(m_cv);
+				}
+				qsbr.Online(&m_qsbrRecord);
+
+				// Woken to release deferred messages, or spuriously
+				if (NormalEmptyLocked() && m_highQueue.empty() && m_workHead == nullptr)
+					continue;
+			}
+
+			// High priority messages first, then alternate between work items
+			// and messages so neither starves
+			if (!m_highQueue.empty())
+			{
+				msg = m_highQueue.front();
+				m_highQueue.pop();
+				if (m_highQueue.empty())
+					m_highPending.store(false, std::memory_order_relaxed);
+			}
+			else if (m_workHead && (NormalEmptyLocked() || m_preferWork))
+			{
+				work = m_workHead;
+				m_workHead = work->m_next;
+				if (m_workHead == nullptr)
+					m_workTail = nullptr;
+			}
+			else
+			{
+				msg = PopNormalLocked();
+				if (m_codelTarget.count() > 0 && CoDelShouldDrop(*msg, std::chrono::steady_clock::now()))
+					drop = true;
+			}
+			m_preferWork = !m_preferWork;
+			if (msg)
+				crossed = UpdateDepthLocked(msg->id, msg->bytes, false);
+		}
+
+		if (crossed)
+			NotifyWatermark();
+
+		// Pick up any newly published configuration snapshots
+		ConfigBroadcastBase::Refresh(m_configSnapshots, m_configVersion);
+
+		// Each dispatch starts a new time slice. The first ShouldYield() call
+		// samples the clock so work done before it counts against the slice.
+		m_sliceDeadline = TscClock::Now() + m_timeSliceTicks;
+		m_yieldChecks = YIELD_CLOCK_STRIDE - 1;
+
+		if (work)
 		{
-			// Wait for a message to be added to the queue
-			std::unique_lock<std::mutex> lk(m_mutex);
-			while (m_queue.empty())
-				m_cv.wait(lk);
+			if (m_statsSlot)
+				StatsBegin(-1, 0);
+			Profiler::SetCurrentMessage(-1);
+			work->Execute();
+			Profiler::SetCurrentMessage(0);
+			if (m_statsSlot)
+				StatsEnd();
+			qsbr.QuiescentState(&m_qsbrRecord);
+			continue;
+		}
 
-			if (m_queue.empty())
-				continue;
+		// Discard cancelled messages without dispatching them
+		if (msg->token.stop_requested())
+		{
+			qsbr.QuiescentState(&m_qsbrRecord);
+			continue;
+		}
 
-			msg = m_queue.front();
-			m_queue.pop();
+		// Shed messages chosen by queue management
+		if (drop)
+		{
+			m_dropped.fetch_add(1, std::memory_order_relaxed);
+			if (m_dropCallback)
+				m_dropCallback(std::static_pointer_cast<UserData>(msg->msg));
+			qsbr.QuiescentState(&m_qsbrRecord);
+			continue;
+		}
+
+		if (m_statsSlot)
+			StatsBegin(msg->id, msg->enqueueTime);
+		Profiler::SetCurrentMessage(msg->id);
+
+		// Posts from the handler inherit its trace. A requeued slice is
+		// stamped again, so keep this dispatch's enqueue time.
+		uint64_t traceEnqueue = 0;
+		uint64_t traceStart = 0;
+		if (msg->trace.traceId != 0)
+		{
+			Tracer::SetCurrent(msg->trace);
+			traceEnqueue = msg->enqueueTime;
+			traceStart = TscClock::Now();
 		}
 
 		switch (msg->id)
@@ -170,20 +1125,84 @@ void WorkerThread::Process()
 				break;
 			}
 
+			case MSG_TASK:
+			{
+				ASSERT_TRUE(msg->msg != NULL);
+
+				auto task = std::static_pointer_cast<std::function<void()>>(msg->msg);
+				(*task)();
+				break;
+			}
+
+			case MSG_SLICED_TASK:
+			{
+				ASSERT_TRUE(msg->msg != NULL);
+
+				// Slices are coarse, so check the dispatch's slice deadline after
+				// each one rather than at ShouldYield()'s sampling stride
+				auto slice = std::static_pointer_cast<std::function<bool()>>(msg->msg);
+				bool more;
+				do
+				{
+					more = (*slice)();
+				} while (more && !m_highPending.load(std::memory_order_relaxed) &&
+					TscClock::Now() < m_sliceDeadline);
+
+				// Continue behind any messages that arrived during this slice
+				if (more)
+					Enqueue(msg, Priority::NORMAL);
+				break;
+			}
+
             case MSG_TIMER:
-                cout << "Timer expired on " << THREAD_NAME << endl;
+            {
+                auto scheduled = std::static_pointer_cast<std::chrono::steady_clock::time_point>(msg->msg);
+                if (m_timerCallback)
+                    m_timerCallback(*scheduled);
+                else
+                    cout << "Timer expired on " << THREAD_NAME << endl;
+                if (m_statsSlot)
+                    PublishStats();
                 break;
+            }
 
 			case MSG_EXIT_THREAD:
 			{
                 m_timerExit = true;
                 timerThread.join();
+                AbandonWork();
+                DestroyLocals();
+                qsbr.Unregister(&m_qsbrRecord);
+                m_configSnapshots.clear();
+                m_configVersion = 0;
+                t_currentWorker = nullptr;
+                Profiler::UnregisterThread();
                 return;
 			}
 
 			default:
 				ASSERT();
 		}
+
+		if (msg->trace.traceId != 0)
+		{
+			Tracer::Record(msg->trace, THREAD_NAME, msg->id, traceEnqueue, traceStart, TscClock::Now());
+			Tracer::SetCurrent(TraceContext());
+		}
+
+		Profiler::SetCurrentMessage(0);
+		if (m_statsSlot)
+			StatsEnd();
+
+		if (msg->hasDeadline)
+		{
+			m_deadlineDispatched.fetch_add(1, std::memory_order_relaxed);
+			if (std::chrono::steady_clock::now() > msg->deadline)
+				m_deadlineMissed.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		// Message boundary. The handler holds no references to RCU protected data.
+		qsbr.QuiescentState(&m_qsbrRecord);
 	}
 }
 
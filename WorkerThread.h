@@ -10,6 +10,16 @@
 #include <atomic>
 #include <condition_variable>
 #include <string>
+#include <vector>
+#include <functional>
+#include <chrono>
+#include <stop_token>
+#include <memory>
+#include <unordered_map>
+#include "Qsbr.h"
+#include "PairingHeap.h"
+#include "StatsSegment.h"
+#include "InstrumentedMutex.h"
 
 struct UserData
 {
@@ -18,10 +28,84 @@ struct UserData
 };
 
 struct ThreadMsg;
+struct RateLimit;
+struct Watermark;
+class SpillFile;
+
+/// Intrusive unit of work posted to a WorkerThread without allocation. The
+/// poster owns the item and keeps it alive until Execute() or Abandon() runs.
+class WorkItem
+{
+public:
+    /// Called on the worker thread when the item is dispatched
+    virtual void Execute() = 0;
+
+    /// Called instead of Execute() if the worker exits before dispatch
+    virtual void Abandon() = 0;
+
+protected:
+    ~WorkItem() = default;
+
+private:
+    friend class WorkerThread;
+    WorkItem* m_next = nullptr;
+};
 
 class WorkerThread
 {
 public:
+    /// Message dispatch priority. High priority messages are dispatched
+    /// before any normal priority message.
+    enum class Priority { NORMAL, HIGH };
+
+    /// Ordering of normal priority messages. FIFO dispatches in arrival order.
+    /// EDF (earliest deadline first) dispatches the message with the earliest
+    /// deadline; ties and messages without an explicit deadline keep arrival order.
+    enum class QueueMode { FIFO, EDF };
+
+    /// Action taken when a rate limited post finds its token bucket empty.
+    /// BLOCK sleeps the producer until a token is available. REJECT refuses
+    /// the message. DEFER holds it and releases it in order as soon as the bucket has tokens.
+    enum class RateLimitPolicy { BLOCK, REJECT, DEFER };
+
+    /// Timer scheduling. SLEEP_FOR sleeps one interval between ticks, so
+    /// dispatch delays accumulate as drift. SLEEP_UNTIL sleeps to absolute
+    /// tick times on a fixed schedule.
+    enum class TimerMode { SLEEP_FOR, SLEEP_UNTIL };
+
+    /// Deadline statistics for messages posted with an explicit deadline
+    struct DeadlineStats
+    {
+        uint64_t dispatched;    ///< Messages with a deadline that were dispatched
+        uint64_t missed;        ///< Of those, messages that completed after their deadline
+    };
+
+    /// Load shedding statistics
+    struct DropStats
+    {
+        uint64_t dropped;       ///< Messages shed by queue management
+        uint64_t episodes;      ///< Times the queue entered the dropping state
+    };
+
+    /// Spill statistics
+    struct SpillStats
+    {
+        uint64_t spilled;       ///< Messages written to the spill file
+        uint64_t fallbacks;     ///< Messages kept in memory because the file was full
+    };
+
+    /// Number of internal message ids counted by QueueSnapshot
+    static const int MSG_ID_COUNT = 6;
+
+    /// View of the pending messages, maintained at push and pop
+    struct QueueSnapshot
+    {
+        size_t depth;                       ///< Messages queued, including spilled ones
+        size_t pendingById[MSG_ID_COUNT];   ///< Queued by id: 1 exit, 2 user data, 3 timer, 4 task, 5 sliced task
+        uint64_t bytes;                     ///< Approximate heap footprint of the queued messages
+        std::chrono::nanoseconds oldestAge; ///< Wait so far of the oldest queued message, zero if empty
+    };
+
     /// Constructor
     WorkerThread(const std::string& threadName);
 
@@ -32,6 +116,16 @@ public:
     /// @return True if thread is created. False otherwise. 
     bool CreateThread();
 
+    /// Pin the worker thread to one CPU. Call before CreateThread().
+    /// @param[in] cpu - the zero based CPU index, or -1 for no affinity
+    void SetCpuAffinity(int cpu) { m_cpuAffinity = cpu; }
+
+    /// Pin a thread to one CPU. Not supported on all platforms.
+    /// @param[in] thread - the thread
+    /// @param[in] cpu - the zero based CPU index
+    /// @return True if the affinity was set
+    static bool SetThreadAffinity(std::thread& thread, int cpu);
+
     /// Called once a program exit to exit the worker thread
     void ExitThread();
 
@@ -43,11 +137,191 @@ public:
     /// @return The current thread ID
     static std::thread::id GetCurrentThreadId();
 
+    /// Get the WorkerThread instance running the calling thread
+    /// @return The current worker, or nullptr if not called from a worker thread
+    static WorkerThread* GetCurrentWorker();
+
     /// Add a message to the thread queue
     /// @param[in] data - thread specific message information
-    void PostMsg(std::shared_ptr<UserData> msg);
+    /// @param[in] priority - the dispatch priority
+    void PostMsg(std::shared_ptr<UserData> msg, Priority priority = Priority::NORMAL);
+
+    /// Add a function to the thread queue to be invoked on the worker thread
+    /// @param[in] task - the function to invoke
+    /// @param[in] priority - the dispatch priority
+    void PostTask(std::function<void()> task, Priority priority = Priority::NORMAL);
+
+    /// Add a cancellable function to the thread queue. If a stop is requested
+    /// before the task is dispatched, it is discarded without running.
+    /// @param[in] task - the function to invoke
+    /// @param[in] token - checked by Process() immediately before dispatch
+    /// @param[in] priority - the dispatch priority
+    void PostTask(std::function<void()> task, std::stop_token token, Priority priority = Priority::NORMAL);
+
+    /// Add a message that should complete by a deadline
+    /// @param[in] data - thread specific message information
+    /// @param[in] deadline - the absolute deadline
+    void PostMsg(std::shared_ptr<UserData> data, std::chrono::steady_clock::time_point deadline);
+
+    /// Add a function that should complete by a deadline
+    /// @param[in] task - the function to invoke
+    /// @param[in] deadline - the absolute deadline
+    void PostTask(std::function<void()> task, std::chrono::steady_clock::time_point deadline);
+
+    /// Set the normal priority queue ordering. Call before CreateThread().
+    /// @param[in] mode - the queue mode
+    void SetQueueMode(QueueMode mode) { m_queueMode = mode; }
+
+    /// Set the relative deadline EDF mode assigns to messages posted without
+    /// one, so they are not starved by a stream of deadline messages. Call
+    /// before CreateThread().
+    /// @param[in] deadline - the relative deadline
+    void SetDefaultDeadline(std::chrono::microseconds deadline) { m_defaultDeadline = deadline; }
+
+    /// Get deadline statistics. Thread-safe.
+    /// @return The deadline dispatch and miss counts
+    DeadlineStats GetDeadlineStats() const;
+
+    /// Enable CoDel active queue management on the normal priority queue.
+    /// Once the minimum time messages wait in the queue stays above target
+    /// for a whole interval, user data messages are shed at an increasing
+    /// rate until the standing delay falls below target. Tasks, timer and
+    /// high priority messages are never shed. Call before CreateThread().
+    /// @param[in] target - acceptable standing queue delay, zero to disable
+    /// @param[in] interval - time the delay may exceed target before shedding
+    void SetCoDel(std::chrono::microseconds target, std::chrono::microseconds interval = std::chrono::milliseconds(100));
+
+    /// Set a function invoked on the worker thread with each shed message.
+    /// Call before CreateThread().
+    /// @param[in] callback - the drop callback
+    void SetDropCallback(std::function<void(std::shared_ptr<UserData>)> callback) { m_dropCallback = std::move(callback); }
+
+    /// Get load shedding statistics. Thread-safe.
+    /// @return The drop counts
+    DropStats GetDropStats() const;
+
+    /// Attach a token bucket rate limit to a key. Keys are chosen by the
+    /// caller, e.g. one per message type or per producer. Call before
+    /// CreateThread().
+    /// @param[in] key - the rate limit key
+    /// @param[in] rate - messages admitted per second
+    /// @param[in] burst - messages admitted back to back when idle
+    /// @param[in] policy - the action when the limit is exceeded
+    void SetRateLimit(int key, double rate, uint32_t burst, RateLimitPolicy policy);
+
+    /// Add a message to the thread queue subject to a rate limit
+    /// @param[in] data - thread specific message information
+    /// @param[in] key - a key registered with SetRateLimit()
+    /// @return False if the message was rejected
+    bool PostMsg(std::shared_ptr<UserData> data, int key);
+
+    /// Register queue depth watermarks for flow control. When the number of
+    /// queued messages rises to high, onHigh is invoked; once it then falls
+    /// to low, onLow is invoked. Crossings in quick succession may coalesce,
+    /// but calls always alternate and the last call matches the final state.
+    /// Call before CreateThread().
+    /// @param[in] high - the high watermark
+    /// @param[in] low - the low watermark, less than high
+    /// @param[in] onHigh - invoked when the high watermark is reached
+    /// @param[in] onLow - invoked when the low watermark is reached after onHigh
+    /// @param[in] notifyThread - the running worker thread that invokes the callbacks
+    void SetWatermarks(size_t high, size_t low, std::function<void()> onHigh, std::function<void()> onLow,
+        WorkerThread& notifyThread);
+
+    /// Get the number of queued messages. Thread-safe.
+    /// @return The queue depth
+    size_t GetQueueDepth() const { return m_queueDepth.load(std::memory_order_relaxed); }
+
+    /// Get contention statistics for the queue lock taken by every post and
+    /// dispatch. Thread-safe.
+    /// @return The lock acquire, contention, wait and hold counters
+    InstrumentedMutex::Stats GetLockStats() const { return m_mutex.GetStats(); }
+
+    /// Inspect the pending messages without taking the queue lock, so it is
+    /// cheap enough to call frequently on a live worker. Counters are read
+    /// individually and may be mutually inconsistent by a message or two.
+    /// In EDF mode only the earliest deadline message counts as a queue head
+    /// for the oldest age. bytes and oldestAge stay zero unless
+    /// SetQueueSnapshotDetail() is enabled, except that SetSpill() also
+    /// tracks the bytes of normal priority messages.
+    /// @return The queue snapshot
+    QueueSnapshot GetQueueSnapshot() const;
+
+    /// Track the queued bytes and oldest message age for GetQueueSnapshot().
+    /// Off by default, as it costs a clock read and a size walk on every post.
+    /// Call before CreateThread().
+    /// @param[in] enable - true to track them
+    void SetQueueSnapshotDetail(bool enable) { m_snapshotDetail = enable; }
+
+    /// Spill the normal priority queue to a memory-mapped file during bursts.
+    /// Once queued messages exceed the memory threshold, further messages
+    /// are appended to the spill file and streamed back into the queue in
+    /// order as the worker drains it. User data is serialized; other
+    /// messages keep their place in the file but stay in memory. The file
+    /// reuses consumed space and grows up to maxFileBytes; if it is full or
+    /// cannot grow, further messages queue in memory behind the file's
+    /// records until it drains. FIFO queue mode only. Call before CreateThread().
+    /// @param[in] threshold - approximate bytes of queued messages kept in memory
+    /// @param[in] directory - the directory for the spill file
+    /// @param[in] maxFileBytes - the largest size the spill file may grow to
+    /// @return False if the spill file could not be created
+    bool SetSpill(size_t threshold, const std::string& directory, size_t maxFileBytes = 1024ull * 1024 * 1024);
+
+    /// Get spill statistics. Thread-safe.
+    /// @return The spill and fallback counts
+    SpillStats GetSpillStats() const;
+
+    /// Add a long running function that is executed in time slices. The slice
+    /// function is called repeatedly until it returns false. Once a high
+    /// priority message is pending or the time slice is used up, the task is
+    /// requeued behind pending messages so high priority messages and timer
+    /// ticks are not delayed.
+    /// @param[in] slice - performs a bounded unit of work; returns true if more remains
+    void PostSlicedTask(std::function<bool()> slice);
+
+    /// Yield point check for long running handlers. Cheap enough to call from
+    /// an inner loop; the clock is sampled only every YIELD_CLOCK_STRIDE calls.
+    /// Only call from this worker's thread.
+    /// @return True if a high priority message is pending or the current
+    /// message has used up its time slice
+    bool ShouldYield();
+
+    /// Set the time slice a handler may run before yielding. Call before CreateThread().
+    /// @param[in] slice - the time slice duration
+    void SetTimeSlice(std::chrono::microseconds slice) { m_timeSlice = slice; }
+
+    /// Set the timer tick interval and scheduling. Call before CreateThread().
+    /// @param[in] interval - the tick interval
+    /// @param[in] mode - the timer scheduling
+    void SetTimer(std::chrono::microseconds interval, TimerMode mode) { m_timerInterval = interval; m_timerMode = mode; }
+
+    /// Set the priority timer ticks are posted at. The default NORMAL keeps
+    /// ticks in order with other posted messages; HIGH lets ticks overtake a
+    /// backlog. Call before CreateThread().
+    /// @param[in] priority - the timer tick priority
+    void SetTimerPriority(Priority priority) { m_timerPriority = priority; }
+
+    /// Set a function invoked on the worker thread at each timer tick in
+    /// place of the default trace output. Call before CreateThread().
+    /// @param[in] callback - receives the tick's scheduled time
+    void SetTimerCallback(std::function<void(std::chrono::steady_clock::time_point)> callback) { m_timerCallback = std::move(callback); }
+
+    /// Add an intrusive work item to the thread queue. No memory is allocated.
+    /// Work items and messages are dispatched alternately when both are pending.
+    /// @param[in] item - the work item, owned by the caller
+    void PostWork(WorkItem* item);
 
 private:
+    friend class ConfigBroadcastBase;
+    friend class WorkerLocalBase;
+
+    /// Storage for one WorkerLocal instance
+    struct LocalSlot
+    {
+        void* obj;
+        void (*destroy)(void*);
+    };
+
     WorkerThread(const WorkerThread&) = delete;
     WorkerThread& operator=(const WorkerThread&) = delete;
 
@@ -57,11 +331,161 @@ private:
     /// Entry point for timer thread
     void TimerThread();
 
+    /// Destroy all WorkerLocal instances. Called on the worker thread at exit.
+    void DestroyLocals();
+
+    /// Abandon pending work items and reject further ones. Called at exit.
+    void AbandonWork();
+
+    /// Enqueue deferred rate limited messages that now have tokens. Called
+    /// by the worker thread before each wait for work.
+    /// @return The time until the next deferred message has a token, or
+    /// nanoseconds::max() if none are deferred
+    std::chrono::nanoseconds ReleaseDeferred();
+
+    /// Record the start and end of a dispatch for the stats segment. Only
+    /// called by the worker thread when m_statsSlot is set.
+    /// @param[in] id - the message id, -1 for a work item
+    /// @param[in] enqueueTime - when the message was queued, in TscClock ticks
+    void StatsBegin(int id, uint64_t enqueueTime);
+    void StatsEnd();
+
+    /// Publish counters to the stats segment. Called on each timer tick.
+    void PublishStats();
+
+    /// Update the queue depth and snapshot counters after a push or pop.
+    /// Caller must hold m_mutex.
+    /// @param[in] id - the message id
+    /// @param[in] bytes - the message's approximate footprint
+    /// @param[in] push - true for a push, false for a pop
+    /// @return True if a watermark was crossed
+    bool UpdateDepthLocked(int id, size_t bytes, bool push);
+
+    /// Post a watermark notification to the notify thread. Called without m_mutex held.
+    void NotifyWatermark();
+
+    /// Add a message to a queue and notify the worker thread
+    /// @param[in] msg - the message
+    /// @param[in] priority - the queue to add the message to
+    void Enqueue(std::shared_ptr<ThreadMsg> msg, Priority priority);
+
+    /// Normal priority queue helpers. Caller must hold m_mutex.
+    bool NormalEmptyLocked() const { return m_queue.empty() && m_edfQueue.Empty() && !m_edfExit && m_spilledCount == 0; }
+    std::shared_ptr<ThreadMsg> PopNormalLocked();
+
+    /// Append a message to the spill file. Caller must hold m_mutex.
+    /// @param[in] msg - the message
+    void SpillLocked(std::shared_ptr<ThreadMsg> msg);
+
+    /// Move spilled messages back into m_queue. Caller must hold m_mutex.
+    void RefillLocked();
+
+    /// CoDel dequeue decision for a normal priority message. Caller must hold m_mutex.
+    /// @param[in] msg - the message just dequeued
+    /// @param[in] now - the dequeue time
+    /// @return True if the message should be shed
+    bool CoDelShouldDrop(const ThreadMsg& msg, std::chrono::steady_clock::time_point now);
+
+    /// Number of ShouldYield() calls between clock samples
+    static const unsigned YIELD_CLOCK_STRIDE = 64;
+
+    /// Orders messages by deadline, then arrival
+    struct DeadlineLess
+    {
+        bool operator()(const std::shared_ptr<ThreadMsg>& a, const std::shared_ptr<ThreadMsg>& b) const;
+    };
+
     std::unique_ptr<std::thread> m_thread;
     std::queue<std::shared_ptr<ThreadMsg>> m_queue;
-    std::mutex m_mutex;
+    std::queue<std::shared_ptr<ThreadMsg>> m_highQueue;
+    std::atomic<bool> m_highPending;
+    PairingHeap<std::shared_ptr<ThreadMsg>, DeadlineLess> m_edfQueue;
+    QueueMode m_queueMode;
+    std::chrono::microseconds m_defaultDeadline;
+    uint64_t m_enqueueSeq;
+
+    /// EDF exit message, held back until the m_edfExitAhead messages queued
+    /// before it (those with seq below m_edfExitSeq) are dispatched
+    std::shared_ptr<ThreadMsg> m_edfExit;
+    uint64_t m_edfExitSeq;
+    size_t m_edfExitAhead;
+    std::atomic<uint64_t> m_deadlineDispatched;
+    std::atomic<uint64_t> m_deadlineMissed;
+
+    /// CoDel state. Guarded by m_mutex.
+    std::chrono::microseconds m_codelTarget;
+    std::chrono::microseconds m_codelInterval;
+    uint64_t m_codelTargetTicks;
+    std::chrono::steady_clock::time_point m_codelFirstAbove;
+    std::chrono::steady_clock::time_point m_codelDropNext;
+    uint32_t m_codelCount;
+    bool m_codelDropping;
+    std::function<void(std::shared_ptr<UserData>)> m_dropCallback;
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<uint64_t> m_dropEpisodes;
+
+    /// Rate limits by key. Read-only once the thread is created.
+    std::unordered_map<int, std::unique_ptr<RateLimit>> m_rateLimits;
+
+    /// Set when a post starts deferring so an idle worker schedules its release
+    std::atomic<bool> m_deferredWake;
+
+    /// Queued message count and snapshot counters, written under m_mutex
+    std::atomic<size_t> m_queueDepth;
+    std::atomic<size_t> m_pendingById[MSG_ID_COUNT];
+    std::atomic<uint64_t> m_pendingBytes;
+    std::atomic<uint64_t> m_oldestEnqueue;
+    bool m_snapshotDetail;
+    std::shared_ptr<Watermark> m_watermark;
+
+    /// Spill state. Guarded by m_mutex. m_spilledCount includes messages in
+    /// m_spillOverflow, which queue behind the file while it is full.
+    std::unique_ptr<SpillFile> m_spill;
+    size_t m_spillThreshold;
+    size_t m_queueBytes;
+    size_t m_spilledCount;
+    std::queue<std::shared_ptr<ThreadMsg>> m_spillResident;
+    std::queue<std::shared_ptr<ThreadMsg>> m_spillOverflow;
+    std::atomic<uint64_t> m_spillWrites;
+    std::atomic<uint64_t> m_spillFallbacks;
+    InstrumentedMutex m_mutex;
     std::condition_variable m_cv;
+    WorkItem* m_workHead;
+    WorkItem* m_workTail;
+    bool m_workClosed;
+    bool m_preferWork;
     std::atomic<bool> m_timerExit;
+    std::chrono::microseconds m_timerInterval;
+    TimerMode m_timerMode;
+    Priority m_timerPriority;
+    std::function<void(std::chrono::steady_clock::time_point)> m_timerCallback;
+    Qsbr::ThreadRecord m_qsbrRecord;
+
+    /// Configuration snapshots cached at the last message boundary. Only
+    /// accessed by the worker thread.
+    std::vector<const void*> m_configSnapshots;
+    uint64_t m_configVersion;
+
+    /// WorkerLocal instances indexed by slot. Only accessed by the worker thread.
+    std::vector<LocalSlot> m_localSlots;
+
+    /// CPU to pin the worker thread to, or -1
+    int m_cpuAffinity;
+
+    /// Live stats slot, or nullptr if no stats segment was created. Set
+    /// before the thread starts; counters are only accessed by the worker thread.
+    StatsSegment::Slot* m_statsSlot;
+    WaitWindow m_waitWindow;
+    uint64_t m_statsDispatched;
+    uint64_t m_statsBusyTicks;
+    uint64_t m_statsDispatchStart;
+
+    /// Time slice state of the message being dispatched. Only accessed by the
+    /// worker thread.
+    std::chrono::microseconds m_timeSlice;
+    uint64_t m_timeSliceTicks;
+    uint64_t m_sliceDeadline;
+    unsigned m_yieldChecks;
     const std::string THREAD_NAME;
 };
 
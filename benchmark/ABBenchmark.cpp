@@ -0,0 +1,216 @@
+#include "ReferenceWorkerThread.h"
+#include "WorkerThread.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <latch>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// A/B comparison of WorkerThread configurations against the original design
+// kept in ReferenceWorkerThread. Every variant runs the same workloads for
+// the same number of repetitions; each result is reported as a mean with a
+// 95% confidence interval, plus the ratio to the reference. A ratio whose
+// interval excludes 1.0 is marked as a win or loss.
+//
+// Usage: ABBenchmark [repetitions] [messages]
+
+using namespace std;
+using namespace std::chrono;
+
+//------------------------------------------------------------------------------
+// Workloads. Each returns the cost of one operation in nanoseconds.
+//------------------------------------------------------------------------------
+template <class Worker>
+static double Throughput(Worker& worker, int producers, int messages)
+{
+	atomic<int> remaining{messages};
+	latch done(1);
+	latch go(producers + 1);
+
+	vector<thread> threads;
+	for (int p = 0; p < producers; p++)
+	{
+		int count = messages / producers + (p < messages % producers ? 1 : 0);
+		threads.emplace_back([&, count]() {
+			go.arrive_and_wait();
+			for (int i = 0; i < count; i++)
+			{
+				worker.PostTask([&]() {
+					if (remaining.fetch_sub(1, memory_order_acq_rel) == 1)
+						done.count_down();
+				});
+			}
+		});
+	}
+
+	auto start = steady_clock::now();
+	go.arrive_and_wait();
+	done.wait();
+	auto elapsed = steady_clock::now() - start;
+	for (auto& t : threads)
+		t.join();
+	return static_cast<double>(duration_cast<nanoseconds>(elapsed).count()) / messages;
+}
+
+template <class Worker>
+static double RoundTrip(Worker& worker, int messages)
+{
+	// Post one task at a time and wait for it, measuring wakeup latency
+	int count = max(1, messages / 10);
+	auto start = steady_clock::now();
+	for (int i = 0; i < count; i++)
+	{
+		latch done(1);
+		worker.PostTask([&done]() { done.count_down(); });
+		done.wait();
+	}
+	return static_cast<double>(duration_cast<nanoseconds>(steady_clock::now() - start).count()) / count;
+}
+
+struct Workload
+{
+	const char* name;
+	int producers;      ///< 0 for round trip
+};
+
+static const Workload WORKLOADS[] =
+{
+	{ "throughput 1 producer",  1 },
+	{ "throughput 4 producers", 4 },
+	{ "round trip",             0 },
+};
+
+template <class Worker>
+static double Run(Worker& worker, const Workload& workload, int messages)
+{
+	if (workload.producers == 0)
+		return RoundTrip(worker, messages);
+	return Throughput(worker, workload.producers, messages);
+}
+
+//------------------------------------------------------------------------------
+// Variants. Each creates a fresh worker per repetition.
+//------------------------------------------------------------------------------
+struct Variant
+{
+	const char* name;
+	function<double(const Workload&, int)> run;
+};
+
+static double RunReference(const Workload& workload, int messages)
+{
+	ReferenceWorkerThread worker("Reference");
+	worker.CreateThread();
+	double ns = Run(worker, workload, messages);
+	worker.ExitThread();
+	return ns;
+}
+
+static function<double(const Workload&, int)> WorkerVariant(function<void(WorkerThread&)> configure)
+{
+	return [configure](const Workload& workload, int messages) {
+		WorkerThread worker("Variant");
+		configure(worker);
+		worker.CreateThread();
+		double ns = Run(worker, workload, messages);
+		worker.ExitThread();
+		return ns;
+	};
+}
+
+//------------------------------------------------------------------------------
+// Statistics
+//------------------------------------------------------------------------------
+struct Summary
+{
+	double mean;
+	double ci;      ///< Half width of the 95% confidence interval
+};
+
+/// Two-sided 95% Student t critical values for 1 to 30 degrees of freedom
+static double TCritical(size_t df)
+{
+	static const double TABLE[] = { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+		2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+		2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+	if (df == 0)
+		return 0;
+	return df <= 30 ? TABLE[df - 1] : 1.96;
+}
+
+static Summary Summarize(const vector<double>& samples)
+{
+	size_t n = samples.size();
+	double mean = 0;
+	for (double s : samples)
+		mean += s;
+	mean /= static_cast<double>(n);
+
+	double variance = 0;
+	for (double s : samples)
+		variance += (s - mean) * (s - mean);
+	variance = n > 1 ? variance / static_cast<double>(n - 1) : 0;
+
+	return { mean, TCritical(n - 1) * sqrt(variance / static_cast<double>(n)) };
+}
+
+//------------------------------------------------------------------------------
+// main
+//------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	int repetitions = argc > 1 ? atoi(argv[1]) : 10;
+	int messages = argc > 2 ? atoi(argv[2]) : 100000;
+	if (repetitions < 2 || messages < 1)
+	{
+		printf("Usage: ABBenchmark [repetitions >= 2] [messages]\n");
+		return 1;
+	}
+
+	// Worker timer ticks trace to cout; results are printed with printf
+	cout.setstate(ios_base::badbit);
+
+	vector<Variant> variants;
+	variants.push_back({ "reference", RunReference });
+	variants.push_back({ "fifo", WorkerVariant([](WorkerThread&) {}) });
+	variants.push_back({ "edf", WorkerVariant([](WorkerThread& w) { w.SetQueueMode(WorkerThread::QueueMode::EDF); }) });
+	variants.push_back({ "codel", WorkerVariant([](WorkerThread& w) { w.SetCoDel(5ms); }) });
+
+	printf("repetitions=%d messages=%d hardware_concurrency=%u\n", repetitions, messages, thread::hardware_concurrency());
+	printf("Cost per operation; ratio is reference / variant, so > 1 is faster than the reference.\n\n");
+
+	for (const Workload& workload : WORKLOADS)
+	{
+		printf("%s\n", workload.name);
+		printf("  %-12s %12s %12s %10s %10s  %s\n", "variant", "ns/op", "+/- 95%", "ratio", "+/- 95%", "verdict");
+
+		// Interleave variants within each repetition so drift in machine state
+		// affects all of them alike
+		vector<vector<double>> samples(variants.size());
+		for (int r = 0; r < repetitions; r++)
+			for (size_t v = 0; v < variants.size(); v++)
+				samples[v].push_back(variants[v].run(workload, messages));
+
+		Summary reference = Summarize(samples[0]);
+		for (size_t v = 0; v < variants.size(); v++)
+		{
+			Summary s = Summarize(samples[v]);
+
+			// Ratio of means with the interval propagated from both relative errors
+			double ratio = reference.mean / s.mean;
+			double ratioCi = v == 0 ? 0 : ratio * sqrt(pow(reference.ci / reference.mean, 2) + pow(s.ci / s.mean, 2));
+			const char* verdict = v == 0 ? "baseline" : ratio - ratioCi > 1 ? "win" : ratio + ratioCi < 1 ? "loss" : "no difference";
+
+			printf("  %-12s %12.1f %12.1f %10.3f %10.3f  %s\n", variants[v].name, s.mean, s.ci, ratio, ratioCi, verdict);
+		}
+		printf("\n");
+		fflush(stdout);
+	}
+	return 0;
+}
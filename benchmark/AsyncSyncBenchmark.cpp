@@ -0,0 +1,228 @@
+#include "AsyncSync.h"
+#include "WorkerThread.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <latch>
+#include <memory>
+#include <mutex>
+#include <semaphore>
+#include <thread>
+#include <vector>
+
+// Compares coroutine-aware AsyncMutex, AsyncSemaphore and AsyncChannel on
+// WorkerThreads against the equivalent blocking std primitives on threads.
+//
+// Usage: AsyncSyncBenchmark [workers] [iterations]
+
+using namespace std;
+using namespace std::chrono;
+
+static void Report(const char* name, size_t ops, steady_clock::duration elapsed)
+{
+	double ns = static_cast<double>(duration_cast<nanoseconds>(elapsed).count());
+	printf("%-40s %10zu ops %10.2f ms %10.1f ns/op\n", name, ops, ns / 1e6, ns / ops);
+}
+
+//------------------------------------------------------------------------------
+// Mutex contention
+//------------------------------------------------------------------------------
+static void BenchStdMutex(int workers, int iterations)
+{
+	mutex lock;
+	uint64_t counter = 0;
+	vector<thread> threads;
+
+	auto start = steady_clock::now();
+	for (int w = 0; w < workers; w++)
+	{
+		threads.emplace_back([&]() {
+			for (int i = 0; i < iterations; i++)
+			{
+				lock_guard<mutex> guard(lock);
+				counter++;
+			}
+		});
+	}
+	for (auto& t : threads)
+		t.join();
+	Report("std::mutex (threads)", counter, steady_clock::now() - start);
+}
+
+static WorkerTask AsyncMutexLoop(WorkerThread& worker, AsyncMutex& lock, uint64_t& counter, int iterations, latch& done)
+{
+	co_await ResumeOn(worker);
+	for (int i = 0; i < iterations; i++)
+	{
+		co_await lock.Lock();
+		counter++;
+		lock.Unlock();
+	}
+	done.count_down();
+}
+
+static void BenchAsyncMutex(vector<unique_ptr<WorkerThread>>& pool, int iterations)
+{
+	AsyncMutex lock;
+	uint64_t counter = 0;
+	latch done(static_cast<ptrdiff_t>(pool.size()));
+
+	auto start = steady_clock::now();
+	for (auto& worker : pool)
+		AsyncMutexLoop(*worker, lock, counter, iterations, done);
+	done.wait();
+	Report("AsyncMutex (coroutines on workers)", counter, steady_clock::now() - start);
+}
+
+//------------------------------------------------------------------------------
+// Semaphore contention. Two permits shared by all workers.
+//------------------------------------------------------------------------------
+static void BenchStdSemaphore(int workers, int iterations)
+{
+	counting_semaphore<> semaphore(2);
+	atomic<uint64_t> counter{0};
+	vector<thread> threads;
+
+	auto start = steady_clock::now();
+	for (int w = 0; w < workers; w++)
+	{
+		threads.emplace_back([&]() {
+			for (int i = 0; i < iterations; i++)
+			{
+				semaphore.acquire();
+				counter.fetch_add(1, memory_order_relaxed);
+				semaphore.release();
+			}
+		});
+	}
+	for (auto& t : threads)
+		t.join();
+	Report("std::counting_semaphore (threads)", counter, steady_clock::now() - start);
+}
+
+static WorkerTask AsyncSemaphoreLoop(WorkerThread& worker, AsyncSemaphore& semaphore, atomic<uint64_t>& counter, int iterations, latch& done)
+{
+	co_await ResumeOn(worker);
+	for (int i = 0; i < iterations; i++)
+	{
+		co_await semaphore.Acquire();
+		counter.fetch_add(1, memory_order_relaxed);
+		semaphore.Release();
+	}
+	done.count_down();
+}
+
+static void BenchAsyncSemaphore(vector<unique_ptr<WorkerThread>>& pool, int iterations)
+{
+	AsyncSemaphore semaphore(2);
+	atomic<uint64_t> counter{0};
+	latch done(static_cast<ptrdiff_t>(pool.size()));
+
+	auto start = steady_clock::now();
+	for (auto& worker : pool)
+		AsyncSemaphoreLoop(*worker, semaphore, counter, iterations, done);
+	done.wait();
+	Report("AsyncSemaphore (coroutines on workers)", counter, steady_clock::now() - start);
+}
+
+//------------------------------------------------------------------------------
+// Bounded channel, one producer and one consumer
+//------------------------------------------------------------------------------
+static const size_t CHANNEL_CAPACITY = 64;
+
+static void BenchStdQueue(int iterations)
+{
+	mutex lock;
+	condition_variable notFull, notEmpty;
+	deque<int> queue;
+	uint64_t sum = 0;
+
+	auto start = steady_clock::now();
+	thread producer([&]() {
+		for (int i = 0; i < iterations; i++)
+		{
+			unique_lock<mutex> lk(lock);
+			notFull.wait(lk, [&]() { return queue.size() < CHANNEL_CAPACITY; });
+			queue.push_back(i);
+			notEmpty.notify_one();
+		}
+	});
+	thread consumer([&]() {
+		for (int i = 0; i < iterations; i++)
+		{
+			unique_lock<mutex> lk(lock);
+			notEmpty.wait(lk, [&]() { return !queue.empty(); });
+			sum += queue.front();
+			queue.pop_front();
+			notFull.notify_one();
+		}
+	});
+	producer.join();
+	consumer.join();
+	Report("std::mutex+condvar queue (threads)", static_cast<size_t>(iterations), steady_clock::now() - start);
+}
+
+static WorkerTask ChannelProducer(WorkerThread& worker, AsyncChannel<int>& channel, int iterations, latch& done)
+{
+	co_await ResumeOn(worker);
+	for (int i = 0; i < iterations; i++)
+		co_await channel.Send(i);
+	done.count_down();
+}
+
+static WorkerTask ChannelConsumer(WorkerThread& worker, AsyncChannel<int>& channel, int iterations, uint64_t& sum, latch& done)
+{
+	co_await ResumeOn(worker);
+	for (int i = 0; i < iterations; i++)
+		sum += co_await channel.Receive();
+	done.count_down();
+}
+
+static void BenchAsyncChannel(vector<unique_ptr<WorkerThread>>& pool, int iterations)
+{
+	AsyncChannel<int> channel(CHANNEL_CAPACITY);
+	uint64_t sum = 0;
+	latch done(2);
+
+	auto start = steady_clock::now();
+	ChannelConsumer(*pool[pool.size() > 1 ? 1 : 0], channel, iterations, sum, done);
+	ChannelProducer(*pool[0], channel, iterations, done);
+	done.wait();
+	Report("AsyncChannel (coroutines on workers)", static_cast<size_t>(iterations), steady_clock::now() - start);
+}
+
+//------------------------------------------------------------------------------
+// main
+//------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	int workers = argc > 1 ? atoi(argv[1]) : 4;
+	int iterations = argc > 2 ? atoi(argv[2]) : 200000;
+	if (workers < 1 || iterations < 1)
+	{
+		printf("Usage: AsyncSyncBenchmark [workers] [iterations]\n");
+		return 1;
+	}
+
+	printf("workers=%d iterations=%d hardware_concurrency=%u\n\n", workers, iterations, thread::hardware_concurrency());
+
+	vector<unique_ptr<WorkerThread>> pool;
+	for (int w = 0; w < workers; w++)
+	{
+		pool.emplace_back(new WorkerThread("BenchWorker" + to_string(w)));
+		pool.back()->CreateThread();
+	}
+
+	BenchStdMutex(workers, iterations);
+	BenchAsyncMutex(pool, iterations);
+	BenchStdSemaphore(workers, iterations);
+	BenchAsyncSemaphore(pool, iterations);
+	BenchStdQueue(iterations);
+	BenchAsyncChannel(pool, iterations);
+
+	for (auto& worker : pool)
+		worker->ExitThread();
+	return 0;
+}
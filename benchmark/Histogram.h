@@ -0,0 +1,108 @@
+#ifndef _HISTOGRAM_H
+#define _HISTOGRAM_H
+
+// Log-linear latency histogram in the style of HdrHistogram.
+//
+// Values below 256 are recorded exactly. Above that each power of two range
+// is split into 128 linear sub-buckets, bounding the relative error of any
+// reported value to under 1% across the full 64-bit range. Recording is an
+// index computation and an increment; not thread-safe, so record on one
+// thread or Merge() per-thread histograms.
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+class Histogram
+{
+public:
+    Histogram() : m_counts(BUCKET_COUNT, 0), m_count(0), m_min(UINT64_MAX), m_max(0), m_sum(0) {}
+
+    /// Record a value
+    /// @param[in] value - the value, e.g. a latency in nanoseconds
+    void Record(uint64_t value)
+    {
+        m_counts[Index(value)]++;
+        m_count++;
+        m_min = std::min(m_min, value);
+        m_max = std::max(m_max, value);
+        m_sum += static_cast<double>(value);
+    }
+
+    /// Add another histogram's values to this one
+    /// @param[in] other - the histogram to add
+    void Merge(const Histogram& other)
+    {
+        for (size_t i = 0; i < BUCKET_COUNT; i++)
+            m_counts[i] += other.m_counts[i];
+        m_count += other.m_count;
+        m_min = std::min(m_min, other.m_min);
+        m_max = std::max(m_max, other.m_max);
+        m_sum += other.m_sum;
+    }
+
+    /// Remove all values
+    void Reset()
+    {
+        std::fill(m_counts.begin(), m_counts.end(), 0);
+        m_count = 0;
+        m_min = UINT64_MAX;
+        m_max = 0;
+        m_sum = 0;
+    }
+
+    /// Get the value at a percentile
+    /// @param[in] percentile - 0 to 100
+    /// @return The highest value equivalent to the percentile's bucket, or 0 if empty
+    uint64_t Percentile(double percentile) const
+    {
+        if (m_count == 0)
+            return 0;
+        uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * static_cast<double>(m_count) + 0.5);
+        rank = std::clamp<uint64_t>(rank, 1, m_count);
+
+        uint64_t seen = 0;
+        for (size_t i = 0; i < BUCKET_COUNT; i++)
+        {
+            seen += m_counts[i];
+            if (seen >= rank)
+                return std::min(HighestEquivalent(i), m_max);
+        }
+        return m_max;
+    }
+
+    uint64_t GetCount() const { return m_count; }
+    uint64_t GetMin() const { return m_count ? m_min : 0; }
+    uint64_t GetMax() const { return m_max; }
+    double GetMean() const { return m_count ? m_sum / static_cast<double>(m_count) : 0.0; }
+
+private:
+    static const unsigned SUB_BUCKET_BITS = 7;
+    static const uint64_t SUB_BUCKETS = 1ull << SUB_BUCKET_BITS;
+    static const size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS) * SUB_BUCKETS + SUB_BUCKETS;
+
+    /// Values below 2 * SUB_BUCKETS map to themselves. Otherwise the value is
+    /// shifted down into [SUB_BUCKETS, 2 * SUB_BUCKETS) and the shift selects
+    /// the range.
+    static size_t Index(uint64_t value)
+    {
+        int shift = std::max(0, static_cast<int>(std::bit_width(value)) - static_cast<int>(SUB_BUCKET_BITS) - 1);
+        return static_cast<size_t>(shift) * SUB_BUCKETS + static_cast<size_t>(value >> shift);
+    }
+
+    static uint64_t HighestEquivalent(size_t index)
+    {
+        size_t shift = index < 2 * SUB_BUCKETS ? 0 : index / SUB_BUCKETS - 1;
+        uint64_t lowest = static_cast<uint64_t>(index - shift * SUB_BUCKETS) << shift;
+        return lowest + ((1ull << shift) - 1);
+    }
+
+    std::vector<uint64_t> m_counts;
+    uint64_t m_count;
+    uint64_t m_min;
+    uint64_t m_max;
+    double m_sum;
+};
+
+#endif
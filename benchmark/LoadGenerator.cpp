@@ -0,0 +1,166 @@
+#include "Histogram.h"
+#include "WorkerThread.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <latch>
+#include <random>
+#include <thread>
+
+// Open-loop load generator. Posts tasks to a WorkerThread on a fixed arrival
+// schedule that does not slow down when the worker falls behind, and measures
+// each task's latency from its intended send time rather than its actual
+// post time, so a stalled producer cannot hide queueing delay (coordinated
+// omission). Sweeps offered load per queue configuration and reports latency
+// percentiles and the saturation knee.
+//
+// Usage: LoadGenerator [constant|poisson] [step-ms] [service-ns]
+
+using namespace std;
+using namespace std::chrono;
+
+enum class Arrival { CONSTANT, POISSON };
+
+struct Config
+{
+	const char* name;
+	WorkerThread::QueueMode mode;
+	WorkerThread::Priority priority;
+	bool deadline;
+};
+
+static const Config CONFIGS[] =
+{
+	{ "fifo",       WorkerThread::QueueMode::FIFO, WorkerThread::Priority::NORMAL, false },
+	{ "edf",        WorkerThread::QueueMode::EDF,  WorkerThread::Priority::NORMAL, true },
+	{ "high-prio",  WorkerThread::QueueMode::FIFO, WorkerThread::Priority::HIGH,   false },
+};
+
+static const double RATES[] = { 10e3, 20e3, 50e3, 100e3, 200e3, 500e3, 1e6 };
+
+/// A step is saturated once achieved throughput falls below this fraction of offered
+static const double KNEE_FRACTION = 0.95;
+
+struct Result
+{
+	double offered;
+	double achieved;
+	Histogram latency;
+};
+
+static void SpinFor(nanoseconds duration)
+{
+	auto end = steady_clock::now() + duration;
+	while (steady_clock::now() < end)
+		;
+}
+
+static void WaitUntil(steady_clock::time_point when)
+{
+	// Sleep for the bulk of long gaps, then yield up to the deadline
+	if (when - steady_clock::now() > 200us)
+		this_thread::sleep_until(when - 100us);
+	while (steady_clock::now() < when)
+		this_thread::yield();
+}
+
+//------------------------------------------------------------------------------
+// RunStep
+//------------------------------------------------------------------------------
+static void RunStep(const Config& config, Arrival arrival, double rate, milliseconds length, nanoseconds service, Result& result)
+{
+	WorkerThread worker("LoadWorker");
+	worker.SetQueueMode(config.mode);
+	worker.CreateThread();
+
+	// Only the worker records; the final latch orders the reads below
+	Histogram& histogram = result.latency;
+	mt19937_64 rng(1);
+	exponential_distribution<double> gap(rate);
+	nanoseconds constantGap(static_cast<int64_t>(1e9 / rate));
+
+	auto start = steady_clock::now() + 1ms;
+	auto end = start + length;
+	auto intended = start;
+	uint64_t sent = 0;
+	while (intended < end)
+	{
+		WaitUntil(intended);
+
+		auto task = [&histogram, intended, service]() {
+			SpinFor(service);
+			histogram.Record(static_cast<uint64_t>(duration_cast<nanoseconds>(steady_clock::now() - intended).count()));
+		};
+		if (config.deadline)
+			worker.PostTask(task, intended + 1ms);
+		else
+			worker.PostTask(task, config.priority);
+		sent++;
+
+		// The schedule is fixed in advance; a late post does not push back later sends
+		if (arrival == Arrival::CONSTANT)
+			intended += constantGap;
+		else
+			intended += duration_cast<nanoseconds>(duration<double>(gap(rng)));
+	}
+
+	latch done(1);
+	worker.PostTask([&done]() { done.count_down(); }, config.priority);
+	done.wait();
+	double elapsed = duration<double>(steady_clock::now() - start).count();
+	worker.ExitThread();
+
+	result.offered = rate;
+	result.achieved = static_cast<double>(sent) / elapsed;
+}
+
+//------------------------------------------------------------------------------
+// main
+//------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	const char* arrivalName = argc > 1 ? argv[1] : "constant";
+	Arrival arrival = strcmp(arrivalName, "poisson") == 0 ? Arrival::POISSON : Arrival::CONSTANT;
+	int stepMs = argc > 2 ? atoi(argv[2]) : 1000;
+	int serviceNs = argc > 3 ? atoi(argv[3]) : 1000;
+	bool validArrival = strcmp(arrivalName, "constant") == 0 || strcmp(arrivalName, "poisson") == 0;
+	if (!validArrival || stepMs < 1 || serviceNs < 0)
+	{
+		printf("Usage: LoadGenerator [constant|poisson] [step-ms] [service-ns]\n");
+		return 1;
+	}
+
+	// Worker timer ticks trace to cout; results are printed with printf
+	cout.setstate(ios_base::badbit);
+
+	printf("arrival=%s step=%dms service=%dns hardware_concurrency=%u\n\n",
+		arrival == Arrival::CONSTANT ? "constant" : "poisson", stepMs, serviceNs, thread::hardware_concurrency());
+	printf("%-10s %12s %12s %10s %10s %10s %10s %10s\n",
+		"config", "offered/s", "achieved/s", "p50 us", "p99 us", "p99.9 us", "max us", "count");
+
+	for (const Config& config : CONFIGS)
+	{
+		double knee = 0;
+		for (double rate : RATES)
+		{
+			Result result;
+			RunStep(config, arrival, rate, milliseconds(stepMs), nanoseconds(serviceNs), result);
+
+			const Histogram& h = result.latency;
+			printf("%-10s %12.0f %12.0f %10.1f %10.1f %10.1f %10.1f %10llu\n", config.name, result.offered, result.achieved,
+				h.Percentile(50) / 1e3, h.Percentile(99) / 1e3, h.Percentile(99.9) / 1e3, h.GetMax() / 1e3,
+				static_cast<unsigned long long>(h.GetCount()));
+
+			if (knee == 0 && result.achieved < result.offered * KNEE_FRACTION)
+				knee = rate;
+		}
+
+		if (knee > 0)
+			printf("%-10s knee: throughput falls below %.0f%% of offered at %.0f/s\n\n", config.name, KNEE_FRACTION * 100, knee);
+		else
+			printf("%-10s knee: not reached\n\n", config.name);
+	}
+	return 0;
+}
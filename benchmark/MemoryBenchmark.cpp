@@ -0,0 +1,249 @@
+#include "WorkerThread.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <latch>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+// Memory footprint per idle WorkerThread and per queued message. Heap usage
+// is measured exactly by replacing the global operator new/delete with a
+// counting version; resident set size is sampled from the OS and includes
+// thread stacks and allocator overhead. RSS deltas are an upper bound once
+// earlier cases have freed memory the allocator can reuse. The spill case
+// creates its file in the current directory.
+//
+// Usage: MemoryBenchmark [idle-workers] [queued-messages]
+
+using namespace std;
+using namespace std::chrono;
+
+//------------------------------------------------------------------------------
+// Counting allocator. Each block is preceded by a header holding its size and
+// the pointer malloc() returned.
+//------------------------------------------------------------------------------
+static atomic<int64_t> g_liveBytes{0};
+static atomic<int64_t> g_allocations{0};
+
+static const size_t HEADER = alignof(max_align_t);
+static_assert(HEADER >= sizeof(size_t) + sizeof(void*), "Header must hold the size and raw pointer");
+
+static void* CountedAlloc(size_t size, size_t align)
+{
+	// malloc() only guarantees max_align_t, so over-allocate for stricter
+	// alignments and round the user pointer up
+	size_t slack = align > HEADER ? align : 0;
+	char* raw = static_cast<char*>(malloc(size + HEADER + slack));
+	if (raw == nullptr)
+		throw bad_alloc();
+	uintptr_t address = (reinterpret_cast<uintptr_t>(raw) + HEADER + align - 1) & ~(static_cast<uintptr_t>(align) - 1);
+	char* user = reinterpret_cast<char*>(address);
+	reinterpret_cast<size_t*>(user)[-1] = size;
+	reinterpret_cast<char**>(user - sizeof(size_t))[-1] = raw;
+	g_liveBytes.fetch_add(static_cast<int64_t>(size), memory_order_relaxed);
+	g_allocations.fetch_add(1, memory_order_relaxed);
+	return user;
+}
+
+static void CountedFree(void* ptr)
+{
+	if (ptr == nullptr)
+		return;
+	char* user = static_cast<char*>(ptr);
+	size_t size = reinterpret_cast<size_t*>(user)[-1];
+	char* raw = reinterpret_cast<char**>(user - sizeof(size_t))[-1];
+	g_liveBytes.fetch_sub(static_cast<int64_t>(size), memory_order_relaxed);
+	free(raw);
+}
+
+void* operator new(size_t size) { return CountedAlloc(size, HEADER); }
+void* operator new[](size_t size) { return CountedAlloc(size, HEADER); }
+void* operator new(size_t size, align_val_t align) { return CountedAlloc(size, static_cast<size_t>(align)); }
+void* operator new[](size_t size, align_val_t align) { return CountedAlloc(size, static_cast<size_t>(align)); }
+void operator delete(void* ptr) noexcept { CountedFree(ptr); }
+void operator delete[](void* ptr) noexcept { CountedFree(ptr); }
+void operator delete(void* ptr, size_t) noexcept { CountedFree(ptr); }
+void operator delete[](void* ptr, size_t) noexcept { CountedFree(ptr); }
+void operator delete(void* ptr, align_val_t) noexcept { CountedFree(ptr); }
+void operator delete[](void* ptr, align_val_t) noexcept { CountedFree(ptr); }
+void operator delete(void* ptr, size_t, align_val_t) noexcept { CountedFree(ptr); }
+void operator delete[](void* ptr, size_t, align_val_t) noexcept { CountedFree(ptr); }
+
+//------------------------------------------------------------------------------
+// Resident set size in bytes, or 0 if unavailable
+//------------------------------------------------------------------------------
+static int64_t ResidentBytes()
+{
+#ifdef WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!K32GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return static_cast<int64_t>(counters.WorkingSetSize);
+#else
+	FILE* file = fopen("/proc/self/statm", "r");
+	if (file == nullptr)
+		return 0;
+	long size = 0, resident = 0;
+	int fields = fscanf(file, "%ld %ld", &size, &resident);
+	fclose(file);
+	return fields == 2 ? static_cast<int64_t>(resident) * sysconf(_SC_PAGESIZE) : 0;
+#endif
+}
+
+struct Snapshot
+{
+	int64_t heap;
+	int64_t allocations;
+	int64_t rss;
+};
+
+static Snapshot Take()
+{
+	return { g_liveBytes.load(), g_allocations.load(), ResidentBytes() };
+}
+
+static void Report(const char* name, size_t units, const Snapshot& before, const Snapshot& after)
+{
+	double n = static_cast<double>(units);
+	printf("%-36s %10zu %14.1f %14.2f %14.1f\n", name, units,
+		static_cast<double>(after.heap - before.heap) / n,
+		static_cast<double>(after.allocations - before.allocations) / n,
+		static_cast<double>(after.rss - before.rss) / n);
+}
+
+//------------------------------------------------------------------------------
+// Idle workers
+//------------------------------------------------------------------------------
+static void MeasureIdleWorkers(int count)
+{
+	Snapshot before = Take();
+	vector<unique_ptr<WorkerThread>> pool;
+	for (int i = 0; i < count; i++)
+	{
+		pool.emplace_back(new WorkerThread("IdleWorker" + to_string(i)));
+		pool.back()->CreateThread();
+	}
+
+	// Let every worker reach its idle wait
+	this_thread::sleep_for(100ms);
+	Report("idle WorkerThread", static_cast<size_t>(count), before, Take());
+
+	for (auto& worker : pool)
+		worker->ExitThread();
+}
+
+//------------------------------------------------------------------------------
+// Queued messages
+//------------------------------------------------------------------------------
+enum class Post { MSG, TASK, WORK };
+
+struct QueueCase
+{
+	const char* name;
+	Post post;
+	WorkerThread::QueueMode mode;
+	WorkerThread::Priority priority;
+	size_t spillThreshold;
+};
+
+static const QueueCase QUEUE_CASES[] =
+{
+	{ "fifo PostMsg",                 Post::MSG,  WorkerThread::QueueMode::FIFO, WorkerThread::Priority::NORMAL, 0 },
+	{ "fifo PostTask",                Post::TASK, WorkerThread::QueueMode::FIFO, WorkerThread::Priority::NORMAL, 0 },
+	{ "edf PostTask",                 Post::TASK, WorkerThread::QueueMode::EDF,  WorkerThread::Priority::NORMAL, 0 },
+	{ "high priority PostTask",       Post::TASK, WorkerThread::QueueMode::FIFO, WorkerThread::Priority::HIGH,   0 },
+	{ "fifo PostMsg, 1MB spill",      Post::MSG,  WorkerThread::QueueMode::FIFO, WorkerThread::Priority::NORMAL, 1024 * 1024 },
+	{ "PostWork (intrusive)",         Post::WORK, WorkerThread::QueueMode::FIFO, WorkerThread::Priority::NORMAL, 0 },
+};
+
+class NopWork : public WorkItem
+{
+public:
+	void Execute() override {}
+	void Abandon() override {}
+};
+
+static void MeasureQueued(const QueueCase& c, int count)
+{
+	WorkerThread worker("QueueWorker");
+	worker.SetQueueMode(c.mode);
+	if (c.spillThreshold > 0 && !worker.SetSpill(c.spillThreshold, "."))
+	{
+		printf("%-36s spill file unavailable\n", c.name);
+		return;
+	}
+	worker.CreateThread();
+
+	// Work items are owned by the poster, so allocate them outside the measurement
+	vector<NopWork> items(c.post == Post::WORK ? count : 0);
+
+	// Hold the worker so every message stays queued
+	latch gate(1);
+	worker.PostTask([&gate]() { gate.wait(); }, WorkerThread::Priority::HIGH);
+	this_thread::sleep_for(10ms);
+
+	Snapshot before = Take();
+	for (int i = 0; i < count; i++)
+	{
+		switch (c.post)
+		{
+			case Post::MSG:
+			{
+				auto data = make_shared<UserData>();
+				data->msg = "msg";
+				data->year = i;
+				worker.PostMsg(data, c.priority);
+				break;
+			}
+			case Post::TASK:
+				worker.PostTask([]() {}, c.priority);
+				break;
+			case Post::WORK:
+				worker.PostWork(&items[i]);
+				break;
+		}
+	}
+	Report(c.name, static_cast<size_t>(count), before, Take());
+
+	gate.count_down();
+	latch done(1);
+	worker.PostTask([&done]() { done.count_down(); });
+	done.wait();
+	worker.ExitThread();
+}
+
+//------------------------------------------------------------------------------
+// main
+//------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	int idleWorkers = argc > 1 ? atoi(argv[1]) : 100;
+	int messages = argc > 2 ? atoi(argv[2]) : 100000;
+	if (idleWorkers < 1 || messages < 1)
+	{
+		printf("Usage: MemoryBenchmark [idle-workers] [queued-messages]\n");
+		return 1;
+	}
+
+	// Worker timer ticks and user data trace to cout; results are printed with printf
+	cout.setstate(ios_base::badbit);
+
+	printf("%-36s %10s %14s %14s %14s\n", "case", "units", "heap B/unit", "allocs/unit", "RSS B/unit");
+	MeasureIdleWorkers(idleWorkers);
+	for (const QueueCase& c : QUEUE_CASES)
+		MeasureQueued(c, messages);
+	return 0;
+}
@@ -0,0 +1,190 @@
+#include "Histogram.h"
+#include "WorkerThread.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <latch>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Core count scaling sweep. For each combination of producer count, worker
+// count, payload size and queue policy, producers post a fixed number of
+// tasks round robin across the workers as fast as they can. Reports
+// throughput and post-to-dispatch latency percentiles as CSV or JSON for
+// plotting against core count.
+//
+// Threads are pinned deterministically: workers on CPUs 0..W-1, producers on
+// the following CPUs, wrapping modulo the CPU count.
+//
+// Usage: ScalingBenchmark [csv|json] [messages] [max-producers] [max-workers]
+
+using namespace std;
+using namespace std::chrono;
+
+struct Policy
+{
+	const char* name;
+	WorkerThread::QueueMode mode;
+	WorkerThread::Priority priority;
+};
+
+static const Policy POLICIES[] =
+{
+	{ "fifo",      WorkerThread::QueueMode::FIFO, WorkerThread::Priority::NORMAL },
+	{ "edf",       WorkerThread::QueueMode::EDF,  WorkerThread::Priority::NORMAL },
+	{ "high-prio", WorkerThread::QueueMode::FIFO, WorkerThread::Priority::HIGH },
+};
+
+static const int PRODUCERS[] = { 1, 2, 4, 8, 16, 32, 64 };
+static const int WORKERS[] = { 1, 2, 4, 8, 16, 32, 64 };
+static const size_t PAYLOADS[] = { 16, 256, 4096 };
+
+struct Result
+{
+	int producers;
+	int workers;
+	size_t payload;
+	const char* policy;
+	int messages;
+	double seconds;
+	Histogram latency;
+};
+
+//------------------------------------------------------------------------------
+// RunCase
+//------------------------------------------------------------------------------
+static void RunCase(int producers, int workers, size_t payload, const Policy& policy, int messages, Result& result)
+{
+	unsigned cpus = max(1u, thread::hardware_concurrency());
+
+	vector<unique_ptr<WorkerThread>> pool;
+	for (int w = 0; w < workers; w++)
+	{
+		pool.emplace_back(new WorkerThread("ScaleWorker" + to_string(w)));
+		pool.back()->SetQueueMode(policy.mode);
+		pool.back()->SetCpuAffinity(static_cast<int>(w % cpus));
+		pool.back()->CreateThread();
+	}
+
+	// One histogram per worker, only recorded by that worker
+	vector<Histogram> histograms(workers);
+	atomic<int> remaining{messages};
+	latch done(1);
+	latch go(producers + 1);
+
+	vector<thread> threads;
+	for (int p = 0; p < producers; p++)
+	{
+		int count = messages / producers + (p < messages % producers ? 1 : 0);
+		threads.emplace_back([&, p, count]() {
+			go.arrive_and_wait();
+			for (int i = 0; i < count; i++)
+			{
+				int w = (p + i) % workers;
+				Histogram* histogram = &histograms[w];
+				vector<char> data(payload, static_cast<char>(i));
+				auto posted = steady_clock::now();
+				pool[w]->PostTask([histogram, posted, data = std::move(data), &remaining, &done]() {
+					histogram->Record(static_cast<uint64_t>(duration_cast<nanoseconds>(steady_clock::now() - posted).count()));
+					volatile char sink = data[data.size() - 1];
+					(void)sink;
+					if (remaining.fetch_sub(1, memory_order_acq_rel) == 1)
+						done.count_down();
+				}, policy.priority);
+			}
+		});
+		WorkerThread::SetThreadAffinity(threads.back(), static_cast<int>((workers + p) % cpus));
+	}
+
+	auto start = steady_clock::now();
+	go.arrive_and_wait();
+	done.wait();
+	double seconds = duration<double>(steady_clock::now() - start).count();
+
+	for (auto& t : threads)
+		t.join();
+	for (auto& worker : pool)
+		worker->ExitThread();
+
+	result.producers = producers;
+	result.workers = workers;
+	result.payload = payload;
+	result.policy = policy.name;
+	result.messages = messages;
+	result.seconds = seconds;
+	for (const Histogram& h : histograms)
+		result.latency.Merge(h);
+}
+
+//------------------------------------------------------------------------------
+// main
+//------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	const char* format = argc > 1 ? argv[1] : "csv";
+	int messages = argc > 2 ? atoi(argv[2]) : 100000;
+	int maxProducers = argc > 3 ? atoi(argv[3]) : 64;
+	int maxWorkers = argc > 4 ? atoi(argv[4]) : 8;
+	bool json = strcmp(format, "json") == 0;
+	if ((!json && strcmp(format, "csv") != 0) || messages < 1 || maxProducers < 1 || maxWorkers < 1)
+	{
+		printf("Usage: ScalingBenchmark [csv|json] [messages] [max-producers] [max-workers]\n");
+		return 1;
+	}
+
+	// Worker timer ticks trace to cout; results are printed with printf
+	cout.setstate(ios_base::badbit);
+
+	if (json)
+		printf("[\n");
+	else
+		printf("producers,workers,payload,policy,messages,seconds,throughput,p50_us,p99_us,p999_us\n");
+
+	bool first = true;
+	for (const Policy& policy : POLICIES)
+	{
+		for (size_t payload : PAYLOADS)
+		{
+			for (int workers : WORKERS)
+			{
+				if (workers > maxWorkers)
+					break;
+				for (int producers : PRODUCERS)
+				{
+					if (producers > maxProducers)
+						break;
+
+					Result r;
+					RunCase(producers, workers, payload, policy, messages, r);
+					double throughput = r.messages / r.seconds;
+					double p50 = r.latency.Percentile(50) / 1e3;
+					double p99 = r.latency.Percentile(99) / 1e3;
+					double p999 = r.latency.Percentile(99.9) / 1e3;
+
+					if (json)
+					{
+						printf("%s  {\"producers\": %d, \"workers\": %d, \"payload\": %zu, \"policy\": \"%s\", \"messages\": %d, "
+							"\"seconds\": %.6f, \"throughput\": %.0f, \"p50_us\": %.2f, \"p99_us\": %.2f, \"p999_us\": %.2f}",
+							first ? "" : ",\n", r.producers, r.workers, r.payload, r.policy, r.messages,
+							r.seconds, throughput, p50, p99, p999);
+					}
+					else
+					{
+						printf("%d,%d,%zu,%s,%d,%.6f,%.0f,%.2f,%.2f,%.2f\n", r.producers, r.workers, r.payload, r.policy,
+							r.messages, r.seconds, throughput, p50, p99, p999);
+					}
+					fflush(stdout);
+					first = false;
+				}
+			}
+		}
+	}
+
+	if (json)
+		printf("\n]\n");
+	return 0;
+}
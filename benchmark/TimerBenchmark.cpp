@@ -0,0 +1,125 @@
+#include "Histogram.h"
+#include "WorkerThread.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Timer accuracy under load. Each worker's timer callback records how late
+// the tick is dispatched relative to its place on the ideal schedule
+// start + n * interval, so both wake-up jitter and accumulated drift show up
+// as lateness. Background load posts busy tasks to every worker at a target
+// utilization. Sweeps timer mode, timer count and load.
+//
+// Usage: TimerBenchmark [seconds-per-case] [interval-ms]
+
+using namespace std;
+using namespace std::chrono;
+
+struct Mode
+{
+	const char* name;
+	WorkerThread::TimerMode mode;
+};
+
+static const Mode MODES[] =
+{
+	{ "sleep_for",   WorkerThread::TimerMode::SLEEP_FOR },
+	{ "sleep_until", WorkerThread::TimerMode::SLEEP_UNTIL },
+};
+
+static const int TIMER_COUNTS[] = { 1, 8, 32 };
+static const double LOADS[] = { 0.0, 0.5, 0.9 };
+
+/// Background load is posted in slots of this length per worker
+static const microseconds LOAD_PERIOD(1000);
+
+static void SpinFor(nanoseconds duration)
+{
+	auto end = steady_clock::now() + duration;
+	while (steady_clock::now() < end)
+		;
+}
+
+//------------------------------------------------------------------------------
+// RunCase
+//------------------------------------------------------------------------------
+static void RunCase(const Mode& mode, int timers, double load, seconds length, milliseconds interval)
+{
+	// One histogram per worker, only recorded by that worker's timer callback.
+	// Ticks scheduled after the case ends, while backlog drains, are ignored.
+	vector<Histogram> histograms(timers);
+	auto end = steady_clock::now() + length;
+	vector<unique_ptr<WorkerThread>> pool;
+	for (int t = 0; t < timers; t++)
+	{
+		Histogram* histogram = &histograms[t];
+		pool.emplace_back(new WorkerThread("TimerWorker" + to_string(t)));
+		pool.back()->SetTimer(interval, mode.mode);
+
+		// Measure scheduling accuracy, not queueing behind the background load
+		pool.back()->SetTimerPriority(WorkerThread::Priority::HIGH);
+		pool.back()->SetTimerCallback([histogram, end](steady_clock::time_point scheduled) {
+			if (scheduled >= end)
+				return;
+			auto late = steady_clock::now() - scheduled;
+			histogram->Record(static_cast<uint64_t>(max<int64_t>(0, duration_cast<nanoseconds>(late).count())));
+		});
+		pool.back()->CreateThread();
+	}
+
+	// Background load: each period, post one busy task per worker sized to the target utilization
+	nanoseconds busy(static_cast<int64_t>(duration_cast<nanoseconds>(LOAD_PERIOD).count() * load));
+	if (load > 0)
+	{
+		auto next = steady_clock::now();
+		while (next < end)
+		{
+			for (auto& worker : pool)
+				worker->PostTask([busy]() { SpinFor(busy); });
+			next += LOAD_PERIOD;
+			this_thread::sleep_until(next);
+		}
+	}
+	else
+	{
+		this_thread::sleep_until(end);
+	}
+
+	for (auto& worker : pool)
+		worker->ExitThread();
+
+	Histogram all;
+	for (const Histogram& h : histograms)
+		all.Merge(h);
+	printf("%-12s %7d %6.0f%% %8llu %10.1f %10.1f %10.1f %10.1f\n", mode.name, timers, load * 100,
+		static_cast<unsigned long long>(all.GetCount()), all.Percentile(50) / 1e3, all.Percentile(99) / 1e3,
+		all.Percentile(99.9) / 1e3, all.GetMax() / 1e3);
+	fflush(stdout);
+}
+
+//------------------------------------------------------------------------------
+// main
+//------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	int caseSeconds = argc > 1 ? atoi(argv[1]) : 2;
+	int intervalMs = argc > 2 ? atoi(argv[2]) : 10;
+	if (caseSeconds < 1 || intervalMs < 1)
+	{
+		printf("Usage: TimerBenchmark [seconds-per-case] [interval-ms]\n");
+		return 1;
+	}
+
+	printf("interval=%dms case=%ds hardware_concurrency=%u\n\n", intervalMs, caseSeconds, thread::hardware_concurrency());
+	printf("%-12s %7s %7s %8s %10s %10s %10s %10s\n", "mode", "timers", "load", "ticks", "p50 us", "p99 us", "p99.9 us", "max us");
+
+	for (const Mode& mode : MODES)
+		for (int timers : TIMER_COUNTS)
+			for (double load : LOADS)
+				RunCase(mode, timers, load, seconds(caseSeconds), milliseconds(intervalMs));
+	return 0;
+}
@@ -1,5 +1,6 @@
 #include "WorkerThread.h"
 #include "Fault.h"
+#include "Future.h"
 #include <iostream>
 
 // @see https://github.com/endurodave/StdWorkerThread
@@ -36,6 +37,13 @@ int main(void)
 	// Post the message to worker thread 2
 	workerThread2.PostMsg(userData2);
 
+	// Produce a value on worker thread 1 and consume it on worker thread 2
+	Promise<int> promise;
+	promise.GetFuture().Then(workerThread2, [](int year) {
+		cout << "Future ready " << year << endl;
+	});
+	workerThread1.PostTask([promise]() mutable { promise.SetValue(2017); });
+
 	// Give time for messages processing on worker threads
 	this_thread::sleep_for(1s);
 
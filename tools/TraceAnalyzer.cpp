@@ -0,0 +1,239 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Offline analysis of a Tracer::Dump() file. Rebuilds each trace's tree of
+// hops, finds its critical path (the chain of hops leading to the span that
+// finished last) and breaks the end-to-end latency down into per-hop queue
+// wait and service time. Prints latency percentiles, the slowest traces'
+// critical paths, and which worker and message id contribute most to
+// critical paths overall.
+//
+// Usage: TraceAnalyzer <trace-file> [slowest-traces]
+
+using namespace std;
+
+struct Span
+{
+	uint64_t traceId;
+	uint64_t spanId;
+	uint64_t parentId;
+	string worker;
+	int msgId;
+	int64_t enqueue;
+	int64_t start;
+	int64_t end;
+	int64_t wait;		// Summed over slices, excluding time between them
+	int64_t service;
+};
+
+struct Trace
+{
+	uint64_t id;
+	int64_t latency;
+	vector<const Span*> path;	// Root first
+};
+
+struct HopTotals
+{
+	uint64_t count = 0;
+	int64_t wait = 0;
+	int64_t service = 0;
+};
+
+//------------------------------------------------------------------------------
+// Parsing
+//------------------------------------------------------------------------------
+static bool Load(const char* path, vector<Span>& spans)
+{
+	ifstream in(path);
+	if (!in)
+		return false;
+
+	// A requeued time-sliced task records one span per slice, each with its
+	// own enqueue. Merge them but sum each slice's wait and service, so time
+	// queued between slices is not counted as service.
+	map<pair<uint64_t, uint64_t>, Span> merged;
+	string line;
+	while (getline(in, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		Span span;
+		istringstream fields(line);
+		string field;
+		vector<string> columns;
+		while (getline(fields, field, '\t'))
+			columns.push_back(field);
+		if (columns.size() != 8)
+			continue;
+		span.traceId = strtoull(columns[0].c_str(), nullptr, 10);
+		span.spanId = strtoull(columns[1].c_str(), nullptr, 10);
+		span.parentId = strtoull(columns[2].c_str(), nullptr, 10);
+		span.worker = columns[3];
+		span.msgId = atoi(columns[4].c_str());
+		span.enqueue = strtoll(columns[5].c_str(), nullptr, 10);
+		span.start = strtoll(columns[6].c_str(), nullptr, 10);
+		span.end = strtoll(columns[7].c_str(), nullptr, 10);
+		span.wait = span.start - span.enqueue;
+		span.service = span.end - span.start;
+
+		auto key = make_pair(span.traceId, span.spanId);
+		auto it = merged.find(key);
+		if (it == merged.end())
+		{
+			merged.emplace(key, span);
+		}
+		else
+		{
+			it->second.enqueue = min(it->second.enqueue, span.enqueue);
+			it->second.start = min(it->second.start, span.start);
+			it->second.end = max(it->second.end, span.end);
+			it->second.wait += span.wait;
+			it->second.service += span.service;
+		}
+	}
+
+	for (auto& entry : merged)
+		spans.push_back(entry.second);
+	return true;
+}
+
+//------------------------------------------------------------------------------
+// Critical paths
+//------------------------------------------------------------------------------
+static vector<Trace> BuildTraces(const vector<Span>& spans)
+{
+	map<uint64_t, vector<const Span*>> byTrace;
+	for (const Span& span : spans)
+		byTrace[span.traceId].push_back(&span);
+
+	vector<Trace> traces;
+	for (auto& entry : byTrace)
+	{
+		unordered_map<uint64_t, const Span*> byId;
+		const Span* last = nullptr;
+		for (const Span* span : entry.second)
+		{
+			byId[span->spanId] = span;
+			if (last == nullptr || span->end > last->end)
+				last = span;
+		}
+
+		// Walk up from the last span to finish. A parent missing from the
+		// dump, e.g. dropped at the span limit, ends the walk early.
+		Trace trace;
+		trace.id = entry.first;
+		for (const Span* span = last; span; )
+		{
+			trace.path.push_back(span);
+			auto parent = byId.find(span->parentId);
+			span = parent == byId.end() ? nullptr : parent->second;
+		}
+		reverse(trace.path.begin(), trace.path.end());
+		trace.latency = last->end - trace.path.front()->enqueue;
+		traces.push_back(move(trace));
+	}
+	return traces;
+}
+
+static void PrintPath(const Trace& trace)
+{
+	printf("trace %llu  %.1f us%s\n", static_cast<unsigned long long>(trace.id), trace.latency / 1e3,
+		trace.path.front()->parentId == 0 ? "" : "  (root missing)");
+	printf("  %-24s %6s %12s %12s %12s\n", "worker", "msg", "wait us", "service us", "posted at us");
+	for (size_t i = 0; i < trace.path.size(); i++)
+	{
+		const Span* span = trace.path[i];
+
+		// How far into the parent's service the child was posted
+		double postedAt = i == 0 ? 0 : (span->enqueue - trace.path[i - 1]->start) / 1e3;
+		printf("  %-24s %6d %12.1f %12.1f %12.1f\n", span->worker.c_str(), span->msgId,
+			span->wait / 1e3, span->service / 1e3, postedAt);
+	}
+}
+
+static double Percentile(const vector<int64_t>& sorted, double percentile)
+{
+	size_t index = static_cast<size_t>(percentile / 100.0 * (sorted.size() - 1) + 0.5);
+	return static_cast<double>(sorted[index]);
+}
+
+//------------------------------------------------------------------------------
+// main
+//------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	int slowest = argc > 2 ? atoi(argv[2]) : 5;
+	if (argc < 2 || slowest < 0)
+	{
+		printf("Usage: TraceAnalyzer <trace-file> [slowest-traces]\n");
+		return 1;
+	}
+
+	vector<Span> spans;
+	if (!Load(argv[1], spans))
+	{
+		printf("Cannot read trace file '%s'\n", argv[1]);
+		return 1;
+	}
+	if (spans.empty())
+	{
+		printf("No spans in '%s'\n", argv[1]);
+		return 0;
+	}
+
+	vector<Trace> traces = BuildTraces(spans);
+	vector<int64_t> latencies;
+	for (const Trace& trace : traces)
+		latencies.push_back(trace.latency);
+	sort(latencies.begin(), latencies.end());
+	printf("%zu traces, %zu spans\n", traces.size(), spans.size());
+	printf("end-to-end us: p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n\n", Percentile(latencies, 50) / 1e3,
+		Percentile(latencies, 90) / 1e3, Percentile(latencies, 99) / 1e3, latencies.back() / 1e3);
+
+	// Slowest traces first
+	sort(traces.begin(), traces.end(), [](const Trace& a, const Trace& b) { return a.latency > b.latency; });
+	for (int i = 0; i < slowest && i < static_cast<int>(traces.size()); i++)
+	{
+		PrintPath(traces[i]);
+		printf("\n");
+	}
+
+	// Where critical path time goes across all traces
+	map<pair<string, int>, HopTotals> hops;
+	int64_t total = 0;
+	for (const Trace& trace : traces)
+	{
+		for (const Span* span : trace.path)
+		{
+			HopTotals& hop = hops[make_pair(span->worker, span->msgId)];
+			hop.count++;
+			hop.wait += span->wait;
+			hop.service += span->service;
+			total += span->wait + span->service;
+		}
+	}
+
+	printf("critical path contribution by hop\n");
+	printf("  %-24s %6s %10s %14s %14s %8s\n", "worker", "msg", "hops", "mean wait us", "mean svc us", "share");
+	vector<pair<pair<string, int>, HopTotals>> ordered(hops.begin(), hops.end());
+	sort(ordered.begin(), ordered.end(), [](const auto& a, const auto& b) {
+		return a.second.wait + a.second.service > b.second.wait + b.second.service;
+	});
+	for (const auto& entry : ordered)
+	{
+		const HopTotals& hop = entry.second;
+		double share = total > 0 ? static_cast<double>(hop.wait + hop.service) * 100.0 / total : 0;
+		printf("  %-24s %6d %10llu %14.1f %14.1f %7.1f%%\n", entry.first.first.c_str(), entry.first.second,
+			static_cast<unsigned long long>(hop.count), hop.wait / 1e3 / hop.count, hop.service / 1e3 / hop.count, share);
+	}
+	return 0;
+}
@@ -0,0 +1,86 @@
+#include "StatsSegment.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Top-like live view of the WorkerThreads in another process. Maps the
+// process's stats segment read-only and redraws a per-worker table each
+// interval. Rates, busy %, queue lock contention % and lock wait per second
+// are computed from the change in counters between refreshes.
+//
+// Usage: WorkerTop [segment-name] [interval-ms] [refreshes]
+
+using namespace std;
+using namespace std::chrono;
+
+int main(int argc, char* argv[])
+{
+	const char* name = argc > 1 ? argv[1] : "WorkerThreadStats";
+	int intervalMs = argc > 2 ? atoi(argv[2]) : 1000;
+	int refreshes = argc > 3 ? atoi(argv[3]) : 0;
+	if (intervalMs < 1 || refreshes < 0)
+	{
+		printf("Usage: WorkerTop [segment-name] [interval-ms] [refreshes, 0 = forever]\n");
+		return 1;
+	}
+
+	StatsSegment segment;
+	if (!segment.Attach(name))
+	{
+		printf("Cannot attach to stats segment '%s'\n", name);
+		return 1;
+	}
+
+	uint32_t slots = segment.GetSlotCount();
+	vector<WorkerStats> previous(slots);
+	vector<bool> seen(slots, false);
+
+	for (int refresh = 0; refreshes == 0 || refresh < refreshes; refresh++)
+	{
+		// Home the cursor and clear the screen
+		printf("\x1b[H\x1b[2J");
+		printf("WorkerTop  segment=%s  slots=%u  interval=%dms\n\n", name, slots, intervalMs);
+		printf("%-24s %8s %12s %12s %7s %12s %12s %9s %9s %8s\n",
+			"worker", "depth", "dispatched", "rate/s", "busy%", "wait p50 us", "wait p99 us", "contend%", "lock us/s", "msg id");
+
+		for (uint32_t i = 0; i < slots; i++)
+		{
+			WorkerStats stats;
+			if (!segment.Read(i, stats))
+			{
+				seen[i] = false;
+				continue;
+			}
+
+			// Rates need two publishes from the same worker
+			double rate = 0;
+			double busy = 0;
+			double contended = 0;
+			double lockWait = 0;
+			if (seen[i] && stats.timestampNs > previous[i].timestampNs && stats.dispatched >= previous[i].dispatched)
+			{
+				double elapsed = static_cast<double>(stats.timestampNs - previous[i].timestampNs);
+				rate = static_cast<double>(stats.dispatched - previous[i].dispatched) * 1e9 / elapsed;
+				busy = static_cast<double>(stats.busyNs - previous[i].busyNs) * 100.0 / elapsed;
+				lockWait = static_cast<double>(stats.lockWaitNs - previous[i].lockWaitNs) * 1e6 / elapsed;
+				uint64_t acquired = stats.lockAcquired - previous[i].lockAcquired;
+				if (acquired > 0)
+					contended = static_cast<double>(stats.lockContended - previous[i].lockContended) * 100.0 / acquired;
+			}
+			if (!seen[i] || stats.timestampNs != previous[i].timestampNs)
+			{
+				previous[i] = stats;
+				seen[i] = true;
+			}
+
+			printf("%-24s %8llu %12llu %12.0f %6.1f%% %12.1f %12.1f %8.1f%% %9.1f %8d\n", stats.name,
+				static_cast<unsigned long long>(stats.queueDepth), static_cast<unsigned long long>(stats.dispatched),
+				rate, busy, stats.waitP50Ns / 1e3, stats.waitP99Ns / 1e3, contended, lockWait, stats.currentMsgId);
+		}
+		fflush(stdout);
+		this_thread::sleep_for(milliseconds(intervalMs));
+	}
+	return 0;
+}